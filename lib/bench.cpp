@@ -0,0 +1,48 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+#include <cstdlib>
+#include <new>
+
+#include "lib/bench.hpp"
+
+
+namespace fcpp {
+
+
+namespace bench {
+
+
+std::atomic<bool>& counting_allocations() {
+    static std::atomic<bool> c{false};
+    return c;
+}
+
+std::atomic<size_t>& allocations() {
+    static std::atomic<size_t> c{0};
+    return c;
+}
+
+
+}
+
+
+}
+
+
+//! @brief Global allocation function, counting allocations when required.
+void* operator new(std::size_t size) {
+    if (fcpp::bench::counting_allocations().load(std::memory_order_relaxed))
+        fcpp::bench::allocations().fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size > 0 ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+//! @brief Global deallocation function, matching the allocation function.
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+//! @brief Global sized deallocation function, matching the allocation function.
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,522 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file bench.hpp
+ * @brief Headless scaling benchmarks of the case studies under the batch simulator.
+ *
+ * A benchmark wraps the program of a case study, counting rounds, received messages
+ * and exported bytes in the node storage, and reports throughput figures as a JSON line,
+ * together with the neighbour discovery measured by its `connect::discovery` connector.
+ * Thread-scaling benchmarks run a case study with `parallel<true>` on an increasing number
+ * of threads, reporting speedup and parallel efficiency against a single thread.
+ * Performance regression runs measure a case study under every combination of the
+ * `export_pointer`, `export_split`, `online_drop`, `parallel` and `synchronised` options,
+ * comparing allocations and exported bytes with a committed baseline file, and wall time
+ * with a baseline file of the machine running them.
+ * The autotuner runs a case study under every combination of the `export_pointer`,
+ * `export_split`, `online_drop` and `parallel` options, and generates a header with
+ * the fastest one.
+ *
+ * Allocations are counted by the global `operator new` replaced in `lib/bench.cpp`,
+ * which needs to be linked into every benchmark executable.
+ */
+
+#ifndef FCPP_BENCH_H_
+#define FCPP_BENCH_H_
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "lib/fcpp.hpp"
+#include "lib/discovery.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+
+
+namespace tags {
+    //! @brief Number of rounds performed by the node.
+    struct bench_rounds {};
+
+    //! @brief Number of messages received by the node.
+    struct bench_msgs {};
+
+    //! @brief Number of bytes exported by the node.
+    struct bench_bytes {};
+}
+
+
+}
+
+
+//! @brief Namespace containing the benchmarking utilities.
+namespace bench {
+
+
+//! @brief The device counts benchmarked by default.
+constexpr size_t sizes[] = {1000, 10000, 100000};
+
+//! @brief The device count of thread-scaling benchmarks.
+constexpr size_t threads_size = sizes[1];
+
+//! @brief The simulated time of a benchmark run.
+constexpr size_t end_time = 20;
+
+//! @brief The sequence of rounds used by benchmarks (about one every second, with 10% variance).
+using round_s = sequence::periodic<
+    distribution::interval_n<times_t, 0, 1>,
+    distribution::weibull_n<times_t, 10, 1, 10>,
+    distribution::constant_n<times_t, end_time>
+>;
+
+//! @brief Side of a square deployment area of `n` devices with the same density as the case studies.
+constexpr size_t side(size_t n) {
+    size_t lo = 0, hi = n * 3000, mid = 0;
+    while (lo < hi) {
+        mid = (lo + hi)/2;
+        if (mid*mid < n * 3000) lo = mid+1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+//! @brief Node storage used by benchmarks (to be added to the one of the case study).
+using store_t = component::tags::tuple_store<
+    coordination::tags::bench_rounds,   size_t,
+    coordination::tags::bench_msgs,     size_t,
+    coordination::tags::bench_bytes,    size_t
+>;
+
+//! @brief Program wrapper running `P` and counting rounds, received messages and exported bytes.
+template <typename P>
+struct program {
+    //! @brief Executes a round of the wrapped program.
+    template <typename node_t>
+    void operator()(node_t& node, times_t t) {
+        P{}(node, t);
+        size_t n = details::get_ids(node.nbr_uid()).size();
+        node.storage(coordination::tags::bench_rounds{}) += 1;
+        node.storage(coordination::tags::bench_msgs{}) += n > 0 ? n-1 : 0;
+        node.storage(coordination::tags::bench_bytes{}) += node.msg_size();
+    }
+};
+
+//! @brief Whether allocations are being counted (only during performance regression runs).
+std::atomic<bool>& counting_allocations();
+
+//! @brief The number of allocations counted.
+std::atomic<size_t>& allocations();
+
+//! @brief Peak resident set size of the current process, in kilobytes.
+inline size_t peak_rss_kb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+//! @brief Figures measured by a benchmark run.
+struct report {
+    //! @brief Wall-clock seconds of the run.
+    double secs;
+    //! @brief Total rounds, received messages and exported bytes.
+    size_t rounds, msgs, bytes;
+    //! @brief Voluntary and involuntary context switches during the run (a measure of contention).
+    long waits, preemptions;
+    //! @brief The neighbour discovery measured during the run.
+    connect::discovery_counters discovery;
+};
+
+//! @brief Runs a network of `n` devices of component `C` (on a given number of threads, if positive).
+template <typename C>
+report measure(size_t n, size_t threads = 0) {
+    using net_t = typename C::net;
+    std::ostream null_stream(nullptr);
+    rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    connect::discovery_registry::get().reset();
+    auto body = [&](auto const& init_v) {
+        net_t network{init_v};
+        auto start = std::chrono::steady_clock::now();
+        network.run();
+        report r{std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 0, 0, 0, 0, 0, {}};
+        for (device_t i = 0; i < n; ++i) if (network.node_count(i)) {
+            auto const& node = network.node_at(i);
+            r.rounds += node.storage(coordination::tags::bench_rounds{});
+            r.msgs   += node.storage(coordination::tags::bench_msgs{});
+            r.bytes  += node.storage(coordination::tags::bench_bytes{});
+        }
+        return r;
+    };
+    report r = threads > 0 ?
+        body(common::make_tagged_tuple<component::tags::output, component::tags::threads>(&null_stream, threads)) :
+        body(common::make_tagged_tuple<component::tags::output>(&null_stream));
+    getrusage(RUSAGE_SELF, &after);
+    r.waits = after.ru_nvcsw - before.ru_nvcsw;
+    r.preemptions = after.ru_nivcsw - before.ru_nivcsw;
+    r.discovery = connect::discovery_registry::get().totals();
+    return r;
+}
+
+//! @brief Prints a JSON report line on `out` (followed by `extra` fields, if any).
+inline void print(std::ostream& out, std::string const& name, size_t n, report const& r, std::string const& extra = "") {
+    out << "{\"program\": \"" << name << "\""
+        << ", \"devices\": " << n
+        << ", \"sim_time\": " << end_time
+        << ", \"wall_s\": " << r.secs
+        << ", \"rounds\": " << r.rounds
+        << ", \"rounds_per_sec\": " << r.rounds / r.secs
+        << ", \"messages_per_sec\": " << r.msgs / r.secs
+        << ", \"bytes_per_round\": " << (r.rounds ? double(r.bytes) / r.rounds : 0.0)
+        << ", \"discovery_tests_per_round\": " << (r.rounds ? double(r.discovery.tests) / r.rounds : 0.0)
+        << ", \"discovery_s\": " << r.discovery.seconds
+        << ", \"peak_rss_kb\": " << peak_rss_kb()
+        << extra
+        << "}" << std::endl;
+}
+
+//! @brief Runs a network of `n` devices of component `C` and prints a JSON report line on `out`.
+template <typename C>
+void run(std::ostream& out, std::string const& name, size_t n) {
+    print(out, name, n, measure<C>(n));
+}
+
+//! @brief Runs component `C` on 1, 2, 4... up to `max_threads` threads, printing a JSON report line per run.
+template <typename C>
+void run_threads(std::ostream& out, std::string const& name, size_t max_threads, bool synchronised) {
+    double base = 0;
+    for (size_t t = 1; ; t = std::min(2*t, max_threads)) {
+        report r = measure<C>(threads_size, t);
+        if (t == 1) base = r.secs;
+        double speedup = base / r.secs;
+        print(out, name, threads_size, r, ", \"synchronised\": " + std::string(synchronised ? "true" : "false") +
+              ", \"threads\": " + std::to_string(t) +
+              ", \"speedup\": " + std::to_string(speedup) +
+              ", \"efficiency\": " + std::to_string(speedup / t) +
+              ", \"waits\": " + std::to_string(r.waits) +
+              ", \"preemptions\": " + std::to_string(r.preemptions));
+        if (t == max_threads) break;
+    }
+}
+
+/**
+ * @brief Entry point of a thread-scaling benchmark executable.
+ *
+ * Usage: `<bench> threads [max_threads [output]]`. Both `synchronised` settings are run on 1, 2, 4...
+ * up to `max_threads` threads (defaulting to the hardware concurrency), with `threads_size` devices.
+ * JSON lines are appended to `output` (or printed on standard output if omitted).
+ *
+ * @tparam C A template of component types with `parallel<true>` parametrised by the `synchronised` option.
+ */
+template <template <bool> class C>
+int threads_main(int argc, char** argv, std::string const& name) {
+    size_t t = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+    if (t == 0) t = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::ofstream file;
+    if (argc > 3) file.open(argv[3], std::ios::app);
+    std::ostream& out = argc > 3 ? file : std::cout;
+    run_threads<C<false>>(out, name, t, false);
+    run_threads<C<true>>(out, name, t, true);
+    return 0;
+}
+
+/**
+ * @brief Entry point of a benchmark executable.
+ *
+ * Usage: `<bench> [devices [output]]`. The device count must be one of `sizes` (all are run if omitted),
+ * and JSON lines are appended to `output` (or printed on standard output if omitted).
+ * Running a single size per process keeps the peak RSS measurement meaningful.
+ *
+ * @tparam C A template of component types parametrised by the number of devices.
+ */
+template <template <size_t> class C>
+int main(int argc, char** argv, std::string const& name) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 0;
+    std::ofstream file;
+    if (argc > 2) file.open(argv[2], std::ios::app);
+    std::ostream& out = argc > 2 ? file : std::cout;
+    bool found = false;
+    if (n == 0 or n == sizes[0]) found = true, run<C<sizes[0]>>(out, name, sizes[0]);
+    if (n == 0 or n == sizes[1]) found = true, run<C<sizes[1]>>(out, name, sizes[1]);
+    if (n == 0 or n == sizes[2]) found = true, run<C<sizes[2]>>(out, name, sizes[2]);
+    if (not found) {
+        std::cerr << "unsupported number of devices: " << n << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//! @brief The device count of performance regression runs.
+constexpr size_t perf_size = sizes[0];
+
+//! @brief The number of combinations of options of performance regression runs.
+constexpr int perf_combinations = 32;
+
+//! @brief The runs of every combination in a performance regression run (the fastest one is kept).
+constexpr size_t perf_reps = 3;
+
+/**
+ * @brief The options of case study `T` for combination `O` of options, numbered as in `test/tester.cpp`.
+ *
+ * The `parallel<(O & 8) == 8>` and `synchronised<(O & 16) == 16>` options need to be set by `T`.
+ */
+template <int O, typename T>
+DECLARE_OPTIONS(perf_options,
+    component::tags::export_pointer<(O & 1) == 1>,
+    component::tags::export_split<(O & 2) == 2>,
+    component::tags::online_drop<(O & 4) == 4>,
+    T
+);
+
+//! @brief Figures compared by performance regression runs.
+struct perf_report {
+    //! @brief Wall-clock seconds of the run.
+    double secs;
+    //! @brief Allocations and exported bytes of the run.
+    size_t allocs, bytes;
+};
+
+//! @brief Baseline figures by program name and combination of options.
+using perf_baseline = std::map<std::pair<std::string, int>, std::vector<double>>;
+
+//! @brief Reads a baseline file (empty if missing), with lines `program combination` followed by the figures.
+inline perf_baseline read_baseline(std::string const& path) {
+    perf_baseline b;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() or line[0] == '#') continue;
+        std::istringstream ss(line);
+        std::string name;
+        int o;
+        double x;
+        if (not (ss >> name >> o)) continue;
+        std::vector<double>& v = b[{name, o}];
+        v.clear();
+        while (ss >> x) v.push_back(x);
+    }
+    return b;
+}
+
+//! @brief Writes a baseline file, whose figures are named by `columns`.
+inline void write_baseline(std::string const& path, std::string const& columns, perf_baseline const& b) {
+    std::ofstream out(path);
+    out.precision(15);
+    out << "# Performance regression baseline, regenerated by the `perf_update` target.\n";
+    out << "# program combination " << columns << "\n";
+    for (auto const& x : b) {
+        out << x.first.first << " " << x.first.second;
+        for (double y : x.second) out << " " << y;
+        out << "\n";
+    }
+}
+
+//! @brief Runs component `C` with `perf_size` devices `perf_reps` times.
+template <typename C>
+perf_report perf_measure() {
+    perf_report p{std::numeric_limits<double>::infinity(), 0, 0};
+    for (size_t i = 0; i < perf_reps; ++i) {
+        size_t a = allocations().load();
+        report r = measure<C>(perf_size);
+        p.secs = std::min(p.secs, r.secs);
+        p.allocs = allocations().load() - a;
+        p.bytes = r.bytes;
+    }
+    return p;
+}
+
+//! @brief Runs every combination of options of component template `C`.
+template <template <int> class C, int... Os>
+std::vector<perf_report> perf_measure(std::integer_sequence<int, Os...>) {
+    return {perf_measure<C<Os>>()...};
+}
+
+/**
+ * @brief Entry point of a performance regression run.
+ *
+ * Usage: `<bench> perf baseline wall_baseline [threshold [update]]`. Every combination of options is run
+ * with `perf_size` devices on the default seed, printing a JSON line per combination with its wall time
+ * (the fastest of `perf_reps` runs), allocations and exported bytes, and their ratios to the figures in the
+ * baseline files. The `baseline` file holds allocations and exported bytes, which do not depend on the
+ * machine, and the `wall_baseline` file holds wall times, which are meaningful on the machine which
+ * measured them only. Figures are only compared if the combination is present in the baseline: missing
+ * ones are reported (with a warning on the number of them), but do not fail.
+ * Fails if any figure exceeds its baseline by more than a fraction `threshold` (0.25 by default).
+ * With `update`, the figures of the program in both baseline files are replaced by the measured ones.
+ *
+ * @tparam C A template of component types parametrised by the combination of options (see `perf_options`).
+ */
+template <template <int> class C>
+int perf_main(int argc, char** argv, std::string const& name) {
+    if (argc < 4) {
+        std::cerr << "usage: " << argv[0] << " perf baseline wall_baseline [threshold [update]]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[2], wall_path = argv[3];
+    double threshold = argc > 4 ? std::strtod(argv[4], nullptr) : 0.25;
+    bool update = argc > 5 and std::string(argv[5]) == "update";
+    perf_baseline base = read_baseline(path);
+    perf_baseline wall = read_baseline(wall_path);
+    counting_allocations() = true;
+    std::vector<perf_report> rs = perf_measure<C>(std::make_integer_sequence<int, perf_combinations>{});
+    counting_allocations() = false;
+    auto ratio = [](double x, double b) {
+        return b > 0 ? x / b : x > 0 ? std::numeric_limits<double>::infinity() : 1.0;
+    };
+    bool regressed = false;
+    int missing = 0;
+    for (int o = 0; o < perf_combinations; ++o) {
+        perf_report const& r = rs[o];
+        std::cout << "{\"program\": \"" << name << "\""
+                  << ", \"combination\": " << o
+                  << ", \"wall_s\": " << r.secs
+                  << ", \"allocations\": " << r.allocs
+                  << ", \"bytes\": " << r.bytes;
+        auto it = base.find({name, o});
+        bool bad = false;
+        if (it != base.end() and it->second.size() == 2) {
+            double ra = ratio(r.allocs, it->second[0]);
+            double rb = ratio(r.bytes, it->second[1]);
+            bad = std::max(ra, rb) > 1 + threshold;
+            std::cout << ", \"allocations_ratio\": " << ra
+                      << ", \"bytes_ratio\": " << rb;
+        } else {
+            std::cout << ", \"missing\": true";
+            ++missing;
+        }
+        auto wt = wall.find({name, o});
+        if (wt != wall.end() and wt->second.size() == 1) {
+            double rw = ratio(r.secs, wt->second[0]);
+            bad = bad or rw > 1 + threshold;
+            std::cout << ", \"wall_ratio\": " << rw;
+        }
+        regressed = regressed or bad;
+        std::cout << ", \"regressed\": " << (bad ? "true" : "false") << "}" << std::endl;
+        if (update) {
+            base[{name, o}] = {double(r.allocs), double(r.bytes)};
+            wall[{name, o}] = {r.secs};
+        }
+    }
+    if (update) {
+        write_baseline(path, "allocations bytes", base);
+        write_baseline(wall_path, "wall_s", wall);
+        return 0;
+    }
+    if (missing > 0)
+        std::cerr << "warning: " << missing << " combinations of " << name << " are missing from " << path << " and were not checked (run the perf_update target to record them)" << std::endl;
+    return regressed ? 1 : 0;
+}
+
+//! @brief The number of combinations of options tried by the autotuner (those with `synchronised<false>`).
+constexpr int tune_combinations = 16;
+
+//! @brief The options tried by the autotuner, by bit of the combination.
+constexpr char const* tune_options[] = {"export_pointer", "export_split", "online_drop", "parallel"};
+
+//! @brief The header declaring the options of combination `o` as `option::<name>_tuned`.
+inline std::string tuned_header(std::string const& path, std::string const& name, int o) {
+    std::string guard = "FCPP_TUNED_" + name + "_H_";
+    std::transform(guard.begin(), guard.end(), guard.begin(), [](unsigned char c){ return std::toupper(c); });
+    std::ostringstream out;
+    out << "// Copyright © 2022 Giorgio Audrito. All Rights Reserved.\n\n"
+        << "/**\n"
+        << " * @file " << path.substr(path.find_last_of('/') + 1) << "\n"
+        << " * @brief The export and parallel options of the " << name << " case study, selected by the autotuner.\n"
+        << " *\n"
+        << " * Generated by `bench_" << name << " tune` (through the `tune` target): do not edit.\n"
+        << " */\n\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n\n"
+        << "#include \"lib/fcpp.hpp\"\n\n\n"
+        << "/**\n"
+        << " * @brief Namespace containing all the objects in the FCPP library.\n"
+        << " */\n"
+        << "namespace fcpp {\n\n\n"
+        << "//! @brief Namespace for component options.\n"
+        << "namespace option {\n\n\n"
+        << "//! @brief The export and parallel options of the " << name << " case study.\n"
+        << "DECLARE_OPTIONS(" << name << "_tuned,\n";
+    for (int i = 0; i < 4; ++i)
+        out << "    component::tags::" << tune_options[i] << "<" << ((o >> i & 1) ? "true" : "false") << ">" << (i < 3 ? "," : "") << "\n";
+    out << ");\n\n\n"
+        << "}\n\n\n"
+        << "}\n\n"
+        << "#endif // " << guard << "\n";
+    return out.str();
+}
+
+/**
+ * @brief Entry point of an autotuning run.
+ *
+ * Usage: `<bench> tune header [report]`. Every combination of the `tune_options` is run as in `perf_main`,
+ * appending a JSON line per combination to `report` (or printing it on standard output if omitted), with
+ * its figures and slowdown with respect to the fastest combination. The options of the fastest one are
+ * written to `header` as `option::<name>_tuned` (the header is left untouched if it already holds them),
+ * which can be reviewed and copied into the options lists of the case study, or included by them.
+ *
+ * @tparam C A template of component types parametrised by the combination of options (see `perf_options`).
+ */
+template <template <int> class C>
+int tune_main(int argc, char** argv, std::string const& name) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " tune header [report]" << std::endl;
+        return 1;
+    }
+    counting_allocations() = true;
+    std::vector<perf_report> rs = perf_measure<C>(std::make_integer_sequence<int, tune_combinations>{});
+    counting_allocations() = false;
+    int best = 0;
+    for (int o = 1; o < tune_combinations; ++o) if (rs[o].secs < rs[best].secs) best = o;
+    std::ofstream file;
+    if (argc > 3) file.open(argv[3], std::ios::app);
+    std::ostream& out = argc > 3 ? file : std::cout;
+    for (int o = 0; o < tune_combinations; ++o) {
+        out << "{\"program\": \"" << name << "\"";
+        for (int i = 0; i < 4; ++i)
+            out << ", \"" << tune_options[i] << "\": " << ((o >> i & 1) ? "true" : "false");
+        out << ", \"wall_s\": " << rs[o].secs
+            << ", \"allocations\": " << rs[o].allocs
+            << ", \"bytes\": " << rs[o].bytes
+            << ", \"slowdown\": " << rs[o].secs / rs[best].secs
+            << ", \"best\": " << (o == best ? "true" : "false")
+            << "}" << std::endl;
+    }
+    std::string header = tuned_header(argv[2], name, best);
+    std::ifstream in(argv[2]);
+    std::stringstream old;
+    old << in.rdbuf();
+    if (old.str() != header) std::ofstream(argv[2]) << header;
+    return 0;
+}
+
+
+}
+
+
+}
+
+#endif // FCPP_BENCH_H_
@@ -12,6 +12,8 @@
 #include "lib/coordination.hpp"
 #include "lib/data.hpp"
 
+#include "lib/multi_gradient.hpp"
+
 
 /**
  * @brief Namespace containing all the objects in the FCPP library.
@@ -68,16 +70,23 @@ namespace tags {
 
 //! @brief Shape of the current node.
     struct node_shape {};
+
+    //! @brief Side of the square area walked by devices (set at initialisation, so that it can scale with the network).
+    struct area_side {};
 }
 
 
 //! @brief Selects an elliptical channel of given width between a source and destination.
 FUN bool channel(ARGS, bool source, bool dest, double width) { CODE
-    double ds = bis_distance(CALL, source, 1, 100);
-    double dd = bis_distance(CALL, dest, 1, 100);
+    // distances from source and destination, broadcasting the destination distance of the source
+    gradients<2> g = bis_gradients(CALL, std::array<bool, 2>{source, dest}, [](std::array<real_t, 2> const& d){
+        return std::array<real_t, 2>{d[1], d[0]};
+    }, 1, 100);
+    double ds = g.dist[0];
+    double dd = g.dist[1];
     node.storage(tags::source_distance{}) = ds;
     node.storage(tags::dest_distance{}) = dd;
-    bool c = ds + dd < broadcast(CALL, ds, dd) + width;
+    bool c = ds + dd < g.value[0] + width;
     c = c or source or dest;
     node.storage(tags::in_channel{}) = c;
     node.storage(tags::distance_c{}) = c ? color::hsva(min(ds,dd)*hue_scale, 1, 1) : color();
@@ -85,11 +94,12 @@ FUN bool channel(ARGS, bool source, bool dest, double width) { CODE
     return c;
 }
 //! @brief Exports for the channel function.
-FUN_EXPORT channel_t = common::export_list<bis_distance_t, broadcast_t<double, double>>;
+FUN_EXPORT channel_t = common::export_list<bis_gradients_t<2>>;
 
 //! @brief Main function.
 MAIN() {
-    rectangle_walk(CALL, make_vec(0,0,0), make_vec(side,side,height), 10, 1);
+    real_t s = node.storage(tags::area_side{});
+    rectangle_walk(CALL, make_vec(0,0,0), make_vec(s,s,height), 10, 1);
     device_t src_id = 0;
     device_t dst_id = 1;
     bool is_src = node.uid == src_id;
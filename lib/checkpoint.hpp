@@ -0,0 +1,94 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file checkpoint.hpp
+ * @brief Forking the state of a simulation into multiple branches.
+ *
+ * A network is simulated up to a chosen time once, and then forked into branches continuing
+ * from that warm state with different parameters. Forking relies on POSIX processes: the whole
+ * network (node storage, exports, random generators and event queue) is shared copy-on-write
+ * by the branches, so that a checkpoint costs no serialisation and memory is duplicated only
+ * where branches diverge.
+ */
+
+#ifndef FCPP_CHECKPOINT_H_
+#define FCPP_CHECKPOINT_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "lib/settings.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the checkpointing utilities.
+namespace checkpoint {
+
+
+//! @brief Simulates a network until its next event is not before a given time.
+template <typename N>
+void run_until(N& network, times_t t) {
+    while (network.next() < t) network.update();
+}
+
+
+/**
+ * @brief Runs `f(i)` for every `i` in `[0, n)` in a branch forked from the current state.
+ *
+ * Branches run concurrently as child processes, and the call returns when all of them
+ * terminated, with the number of branches which failed. Output streams are flushed
+ * before forking, so that buffered output is not duplicated. Only the forking thread
+ * survives in the branches: the network must be sequential (`parallel<false>`), since
+ * the worker threads of a parallel network would be missing in the branches.
+ */
+template <typename F>
+size_t branches(size_t n, F&& f) {
+#ifdef _WIN32
+    std::cerr << "checkpoint::branches is not supported on Windows" << std::endl;
+    return n;
+#else
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    std::vector<pid_t> children;
+    size_t failed = 0;
+    for (size_t i = 0; i < n; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            f(i);
+            std::cout.flush();
+            std::cerr.flush();
+            std::fflush(nullptr);
+            std::_Exit(0);
+        }
+        if (pid < 0) ++failed;
+        else children.push_back(pid);
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (not WIFEXITED(status) or WEXITSTATUS(status) != 0) ++failed;
+    }
+    return failed;
+#endif
+}
+
+
+}
+
+
+}
+
+#endif // FCPP_CHECKPOINT_H_
@@ -8,10 +8,13 @@
 #ifndef FCPP_COLLECTION_COMPARE_H_
 #define FCPP_COLLECTION_COMPARE_H_
 
+#include "lib/fcpp.hpp"
 #include "lib/beautify.hpp"
 #include "lib/coordination.hpp"
 #include "lib/data.hpp"
 
+#include "lib/snapshot.hpp"
+
 
 /**
  * @brief Namespace containing all the objects in the FCPP library.
@@ -27,6 +30,9 @@ namespace tags {
     //! @brief Desired distance algorithm.
     struct algorithm {};
 
+    //! @brief Length of the strip walked by devices (set at initialisation, so that it can scale with the network).
+    struct area_length {};
+
     //! @brief Output values.
     //! @{
     struct spc_sum {};
@@ -38,9 +44,18 @@ namespace tags {
     struct wmpc_max {};
     struct ideal_max {};
     //! @}
+
+    //! @brief Output value T of the distance algorithm a (when comparing algorithms side by side).
+    template <typename T, int a>
+    struct by_algorithm {};
 }
 
 
+//! @brief Tag storing the output T of the distance algorithm a (T itself if a is negative).
+template <typename T, int a>
+using output_tag = std::conditional_t<(a < 0), T, tags::by_algorithm<T, a>>;
+
+
 //! @brief Computes the distance from a source through adaptive bellmann-ford with old+nbr.
 FUN double generic_distance(ARGS, int algorithm, bool source) { CODE
     if (algorithm == 0) return abf_distance(CALL, source);
@@ -51,8 +66,9 @@ FUN double generic_distance(ARGS, int algorithm, bool source) { CODE
 //! @brief Exports for the generic_distance function.
 FUN_EXPORT generic_distance_t = common::export_list<abf_distance_t, bis_distance_t, flex_distance_t>;
 
-//! @brief Device counting case study.
-FUN void device_counting(ARGS, bool is_source, double dist) { CODE
+//! @brief Device counting case study (storing outputs for the distance algorithm a, if not negative).
+template <int a = -1, typename node_t>
+void device_counting(node_t& node, trace_t call_point, bool is_source, double dist) { CODE
     auto adder = [](double x, double y) {
         return x+y;
     };
@@ -65,19 +81,21 @@ FUN void device_counting(ARGS, bool is_source, double dist) { CODE
     double spc = sp_collection(CALL, dist, 1.0, 0.0, adder);
     double mpc = mp_collection(CALL, dist, 1.0, 0.0, adder, divider);
     double wmpc = wmp_collection(CALL, dist, 100.0, 1.0, adder, multiplier);
-    node.storage(tags::spc_sum{}) = is_source ? spc : 0;
-    node.storage(tags::mpc_sum{}) = is_source ? mpc : 0;
-    node.storage(tags::wmpc_sum{}) = is_source ? wmpc : 0;
+    node.storage(output_tag<tags::spc_sum, a>{}) = is_source ? spc : 0;
+    node.storage(output_tag<tags::mpc_sum, a>{}) = is_source ? mpc : 0;
+    node.storage(output_tag<tags::wmpc_sum, a>{}) = is_source ? wmpc : 0;
     node.storage(tags::ideal_sum{}) = 1.0;
 }
 //! @brief Exports for the device_counting function.
 FUN_EXPORT device_counting_t = common::export_list<sp_collection_t<double, double>, mp_collection_t<double, double>, wmp_collection_t<double>>;
 
-//! @brief Progress tracking case study.
-FUN void progress_tracking(ARGS, bool is_source, device_t source_id, double dist) { CODE
-    vec<2> source_pos = node.position();
-    if (node.net.node_count(source_id))
-        source_pos = node.net.node_at(source_id).position(node.current_time());
+//! @brief Progress tracking case study (storing outputs for the distance algorithm a, if not negative).
+template <int a = -1, typename node_t>
+void progress_tracking(node_t& node, trace_t call_point, bool is_source, device_t source_id, double dist) { CODE
+    snapshot::device_state<2> source = snapshot::selected_state<2>(node, [source_id](times_t){
+        return source_id;
+    });
+    vec<2> source_pos = source.present ? source.position_at(node.current_time()) : node.position();
     double value = distance(node.position(), source_pos) + (500 - node.current_time());
     double threshold = 3.5 / count_hood(CALL);
     
@@ -93,9 +111,9 @@ FUN void progress_tracking(ARGS, bool is_source, device_t source_id, double dist
     double spc = sp_collection(CALL, dist, value, 0.0, adder);
     double mpc = mp_collection(CALL, dist, value, 0.0, adder, divider);
     double wmpc = wmp_collection(CALL, dist, 100.0, value, adder, multiplier);
-    node.storage(tags::spc_max{}) = is_source ? spc : 0;
-    node.storage(tags::mpc_max{}) = is_source ? mpc : 0;
-    node.storage(tags::wmpc_max{}) = is_source ? wmpc : 0;
+    node.storage(output_tag<tags::spc_max, a>{}) = is_source ? spc : 0;
+    node.storage(output_tag<tags::mpc_max, a>{}) = is_source ? mpc : 0;
+    node.storage(output_tag<tags::wmpc_max, a>{}) = is_source ? wmpc : 0;
     node.storage(tags::ideal_max{}) = value;
 }
 //! @brief Exports for the progress_tracking function.
@@ -103,7 +121,7 @@ FUN_EXPORT progress_tracking_t = common::export_list<sp_collection_t<double, dou
 
 //! @brief Main function.
 MAIN() {
-    rectangle_walk(CALL, make_vec(0,0), make_vec(2000,200), 30.5, 1);
+    rectangle_walk(CALL, make_vec(0,0), make_vec(node.storage(tags::area_length{}),200), 30.5, 1);
     
     device_t source_id = node.current_time() < 250 ? 0 : 1;
     bool is_source = node.uid == source_id;
@@ -116,6 +134,65 @@ MAIN() {
 //! @brief Exports for the main function.
 FUN_EXPORT main_t = common::export_list<rectangle_walk_t<2>, generic_distance_t, device_counting_t, progress_tracking_t>;
 
+//! @brief Runs the case studies for every distance algorithm side by side, on the same network (with source switching to `switch_id` at time 250).
+FUN void compare_all(ARGS, device_t switch_id = 1) { CODE
+    rectangle_walk(CALL, make_vec(0,0), make_vec(node.storage(tags::area_length{}),200), 30.5, 1);
+    
+    device_t source_id = node.current_time() < 250 ? 0 : switch_id;
+    bool is_source = node.uid == source_id;
+    double abf = generic_distance(CALL, 0, is_source);
+    double bis = generic_distance(CALL, 1, is_source);
+    double flex = generic_distance(CALL, 2, is_source);
+    
+    device_counting<0>(CALL, is_source, abf);
+    device_counting<1>(CALL, is_source, bis);
+    device_counting<2>(CALL, is_source, flex);
+    progress_tracking<0>(CALL, is_source, source_id, abf);
+    progress_tracking<1>(CALL, is_source, source_id, bis);
+    progress_tracking<2>(CALL, is_source, source_id, flex);
+}
+//! @brief Exports for the compare_all function.
+FUN_EXPORT compare_all_t = common::export_list<rectangle_walk_t<2>, generic_distance_t, device_counting_t, progress_tracking_t>;
+
+//! @brief Main program running every distance algorithm side by side (alternative to main).
+struct main_all {
+    //! @brief Executes a round of the program.
+    template <typename node_t>
+    void operator()(node_t& node, times_t) {
+        compare_all(node, 0);
+    }
+};
+
+
+}
+
+
+//! @brief Namespace for component options.
+namespace option {
+
+
+//! @brief Node storage for the outputs of the distance algorithm a (the plain tags if negative).
+template <int a>
+using algo_store_t = component::tags::tuple_store<
+    coordination::output_tag<coordination::tags::spc_sum, a>,   double,
+    coordination::output_tag<coordination::tags::mpc_sum, a>,   double,
+    coordination::output_tag<coordination::tags::wmpc_sum, a>,  double,
+    coordination::output_tag<coordination::tags::spc_max, a>,   double,
+    coordination::output_tag<coordination::tags::mpc_max, a>,   double,
+    coordination::output_tag<coordination::tags::wmpc_max, a>,  double
+>;
+
+//! @brief Aggregators for the outputs of the distance algorithm a (the plain tags if negative).
+template <int a>
+using algo_aggregator_t = component::tags::aggregators<
+    coordination::output_tag<coordination::tags::spc_sum, a>,   aggregator::sum<double>,
+    coordination::output_tag<coordination::tags::mpc_sum, a>,   aggregator::sum<double>,
+    coordination::output_tag<coordination::tags::wmpc_sum, a>,  aggregator::sum<double>,
+    coordination::output_tag<coordination::tags::spc_max, a>,   aggregator::max<double>,
+    coordination::output_tag<coordination::tags::mpc_max, a>,   aggregator::max<double>,
+    coordination::output_tag<coordination::tags::wmpc_max, a>,  aggregator::max<double>
+>;
+
 
 }
 
@@ -0,0 +1,307 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file columnar.hpp
+ * @brief Columnar binary logging of aggregator rows, replayable into plotters.
+ *
+ * A `columnar::log_file<P, Ks...>` can be used as `plot_type` of simulations in place of a plotter `P`.
+ * Every logged row is appended to a set of files, one per column (`<path>.<i>.col`), each
+ * a raw array of doubles which can be memory-mapped; the file `<path>.head` lists the number
+ * and names of the columns. After the simulations, `replay` reads the columns back and feeds
+ * the rows into a plotter of type `P` (as if it had received them directly), while
+ * `export_text` writes them as text, in the format of the logger: the columns `Ks...` are the
+ * parameters of a run, and every run is preceded by a header with its parameters and the
+ * names of the other columns.
+ */
+
+#ifndef FCPP_COLUMNAR_H_
+#define FCPP_COLUMNAR_H_
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "lib/common/tagged_tuple.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the columnar binary logging format.
+namespace columnar {
+
+
+//! @brief Read-only view of a column file (memory-mapped if possible).
+class column {
+  public:
+    //! @brief Opens a column file.
+    column(std::string const& path) {
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 and fstat(fd, &st) == 0 and st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                m_map = p;
+                m_size = st.st_size / sizeof(double);
+            }
+        }
+        if (fd >= 0) close(fd);
+#else
+        std::ifstream f(path, std::ios::binary | std::ios::ate);
+        m_data.resize(f ? size_t(f.tellg()) / sizeof(double) : 0);
+        f.seekg(0);
+        f.read((char*)m_data.data(), m_data.size() * sizeof(double));
+        m_size = m_data.size();
+#endif
+    }
+
+    //! @brief Copying is disabled.
+    column(column const&) = delete;
+
+    //! @brief Move constructor.
+    column(column&& o) : m_map(o.m_map), m_size(o.m_size), m_data(std::move(o.m_data)) {
+        o.m_map = nullptr;
+    }
+
+    //! @brief Unmaps the file.
+    ~column() {
+#ifndef _WIN32
+        if (m_map) munmap(m_map, m_size * sizeof(double));
+#endif
+    }
+
+    //! @brief Number of values in the column.
+    size_t size() const {
+        return m_size;
+    }
+
+    //! @brief Access to the i-th value.
+    double operator[](size_t i) const {
+        return m_map ? static_cast<double const*>(m_map)[i] : m_data[i];
+    }
+
+  private:
+    //! @brief The memory-mapped data (if mapped).
+    void* m_map = nullptr;
+    //! @brief The number of values.
+    size_t m_size = 0;
+    //! @brief The data (if not mapped).
+    std::vector<double> m_data;
+};
+
+
+//! @brief Path of the i-th column file of a log.
+inline std::string column_path(std::string const& path, size_t i) {
+    return path + "." + std::to_string(i) + ".col";
+}
+
+
+//! @brief Reads the columns of a log at a given path.
+inline std::vector<column> read_columns(std::string const& path, size_t n) {
+    std::vector<column> cols;
+    for (size_t i = 0; i < n; ++i) cols.emplace_back(column_path(path, i));
+    return cols;
+}
+
+
+//! @brief Namespace of implementation details.
+namespace details {
+    //! @brief Helper class processing rows of a given type, with parameter tags Ks.
+    template <typename R, typename... Ks>
+    struct row_io;
+
+    //! @brief Helper class processing rows of a given type, with parameter tags Ks (tagged tuple specialisation).
+    template <typename... Ss, typename... Ts, typename... Ks>
+    struct row_io<common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>>, Ks...> {
+        //! @brief The row type.
+        using row_type = common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>>;
+
+        //! @brief The number of columns.
+        static constexpr size_t size = sizeof...(Ss);
+
+        //! @brief The names of the columns (as printed by loggers).
+        static std::vector<std::string> names() {
+            return {common::details::strip_namespaces(common::type_name<Ss>())...};
+        }
+
+        //! @brief Whether a tag is a parameter of a run.
+        template <typename S>
+        static bool param() {
+            bool b[] = {false, std::is_same<S, Ks>::value...};
+            for (bool x : b) if (x) return true;
+            return false;
+        }
+
+        //! @brief Whether the columns are parameters of a run.
+        static std::vector<bool> params() {
+            return {param<Ss>()...};
+        }
+
+        //! @brief Appends a row to the column files, returning the index of the first column which could not be written (or `size`).
+        static size_t write(std::vector<FILE*>& files, row_type const& row) {
+            double vals[] = {double(common::get<Ss>(row))...};
+            for (size_t i = 0; i < size; ++i) if (fwrite(vals + i, sizeof(double), 1, files[i]) != 1) return i;
+            return size;
+        }
+
+        //! @brief Reads the i-th row from the columns.
+        static row_type read(std::vector<column> const& cols, size_t i) {
+            row_type row;
+            size_t k = 0;
+            int unused[] = {0, (common::get<Ss>(row) = Ts(cols[k++][i]), 0)...};
+            (void)unused;
+            return row;
+        }
+    };
+}
+
+
+//! @brief Output stream discarding everything (to disable the text output of loggers).
+inline std::ostream& null_stream() {
+    struct null_buffer : std::streambuf {
+        int overflow(int c) override {
+            return c;
+        }
+    };
+    static null_buffer b;
+    static std::ostream o(&b);
+    return o;
+}
+
+
+/**
+ * @brief Plotter appending rows to a columnar binary log, replayable into a plotter of type `P`.
+ *
+ * Rows are expected to be all of the same type (as it happens for the rows of a logger).
+ * Failing to create or write the files of the log throws a `std::runtime_error`: the log is
+ * created on construction, so that a missing or read-only directory fails before any simulation.
+ */
+template <typename P, typename... Ks>
+class log_file {
+  public:
+    //! @brief Opens a log at a given path (overwriting or appending to existing files).
+    log_file(std::string path, bool append = false) : m_path(std::move(path)), m_append(append) {
+        std::ofstream head(m_path + ".head", append ? std::ios::app : std::ios::out);
+        if (not head) throw std::runtime_error("cannot create the columnar log " + m_path);
+    }
+
+    //! @brief Closes the column files.
+    ~log_file() {
+        close();
+    }
+
+    //! @brief Appends a row.
+    template <typename R>
+    log_file& operator<<(R const& row) {
+        using io = details::row_io<R, Ks...>;
+        std::lock_guard<std::mutex> l(m_mutex);
+        if (m_files.empty()) {
+            std::ofstream head(m_path + ".head");
+            head << io::size << "\n";
+            for (std::string const& s : io::names()) head << s << "\n";
+            if (not head) throw std::runtime_error("cannot write " + m_path + ".head");
+            for (size_t i = 0; i < io::size; ++i) {
+                FILE* f = std::fopen(column_path(m_path, i).c_str(), m_append ? "ab" : "wb");
+                if (f == nullptr) {
+                    for (FILE* g : m_files) std::fclose(g);
+                    m_files.clear();
+                    throw std::runtime_error("cannot open " + column_path(m_path, i));
+                }
+                m_files.push_back(f);
+            }
+            m_append = true;
+            m_replay = [](std::string const& path, P& p) {
+                std::vector<column> cols = read_columns(path, io::size);
+                size_t n = cols.empty() ? 0 : cols[0].size();
+                for (size_t i = 0; i < n; ++i) p << io::read(cols, i);
+            };
+            m_text = [](std::string const& path, std::ostream& o) {
+                std::vector<column> cols = read_columns(path, io::size);
+                std::vector<std::string> names = io::names();
+                std::vector<bool> params = io::params();
+                size_t n = cols.empty() ? 0 : cols[0].size();
+                std::vector<double> run;
+                for (size_t i = 0; i < n; ++i) {
+                    std::vector<double> r;
+                    for (size_t j = 0; j < cols.size(); ++j) if (params[j]) r.push_back(cols[j][i]);
+                    if (i == 0 or r != run) {
+                        run = r;
+                        o << (i ? "\n" : "") << "##########################################################\n# ";
+                        bool first = true;
+                        for (size_t j = 0; j < cols.size(); ++j) if (params[j]) {
+                            o << (first ? "" : ", ") << names[j] << " = " << cols[j][i];
+                            first = false;
+                        }
+                        o << "\n##########################################################\n#\n# The columns have the following meaning:\n#";
+                        for (size_t j = 0; j < cols.size(); ++j) if (not params[j]) o << " " << names[j];
+                        o << "\n";
+                    }
+                    for (size_t j = 0, k = 0; j < cols.size(); ++j) if (not params[j]) o << (k++ ? " " : "") << cols[j][i];
+                    o << "\n";
+                }
+            };
+        }
+        size_t i = io::write(m_files, row);
+        if (i < io::size) throw std::runtime_error("cannot write " + column_path(m_path, i));
+        return *this;
+    }
+
+    //! @brief Feeds every logged row into a plotter.
+    void replay(P& p) {
+        close();
+        if (m_replay) m_replay(m_path, p);
+    }
+
+    //! @brief Writes every logged row as text, one line per row.
+    void export_text(std::ostream& o) {
+        close();
+        if (m_text) m_text(m_path, o);
+    }
+
+  private:
+    //! @brief Closes the column files, flushing them.
+    void close() {
+        std::lock_guard<std::mutex> l(m_mutex);
+        for (FILE* f : m_files) std::fclose(f);
+        m_files.clear();
+    }
+
+    //! @brief The base path of the log.
+    std::string m_path;
+    //! @brief Whether existing files are appended to.
+    bool m_append;
+    //! @brief The open column files.
+    std::vector<FILE*> m_files;
+    //! @brief Replays the rows at a path into a plotter (set by the first row).
+    std::function<void(std::string const&, P&)> m_replay;
+    //! @brief Writes the rows at a path as text (set by the first row).
+    std::function<void(std::string const&, std::ostream&)> m_text;
+    //! @brief Serialises concurrent writes.
+    std::mutex m_mutex;
+};
+
+
+}
+
+
+}
+
+#endif // FCPP_COLUMNAR_H_
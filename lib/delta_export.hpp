@@ -0,0 +1,194 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file delta_export.hpp
+ * @brief Delta encoding of values shared with neighbours across consecutive rounds.
+ *
+ * Once a program stabilises, most shared values are the same as in the previous round.
+ * The `delta_nbr` function shares a value as `nbr` does, but serialises it as a version
+ * marker whenever every neighbour acknowledged the current version of the value, so that
+ * the saving is accounted for in `node.msg_size()`. Every device numbers the values it
+ * shares with increasing versions, and echoes back to each neighbour the version of its
+ * value it holds: the value is sent in full as long as some neighbour did not echo its
+ * current version (as it is new, or skipped rounds, or received messages out of order).
+ * Receivers decode a marker as the last value received in full from that neighbour, if it
+ * has the same version, and otherwise ask for a full value by echoing no version.
+ *
+ * The versions and values needed to encode and decode are kept in the node storage (in a tag
+ * of type `delta_memory<T>`), and are not part of the exports. The values received from devices
+ * which are no longer neighbours are kept for a retention time, so that markers can be decoded
+ * when they come back into range.
+ */
+
+#ifndef FCPP_DELTA_EXPORT_H_
+#define FCPP_DELTA_EXPORT_H_
+
+#include <unordered_map>
+#include <utility>
+
+#include "lib/coordination.hpp"
+#include "lib/data.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief A versioned value, shared in full or as a marker of its version.
+template <typename T>
+struct delta {
+    //! @brief The value (meaningful only when sent in full).
+    T value;
+    //! @brief The version of the value (negative if no value was shared).
+    int version = -1;
+    //! @brief Whether the value is sent in full.
+    bool full = true;
+
+    //! @brief Serialises the content from/to a given input/output stream.
+    template <typename S>
+    S& serialize(S& s) {
+        s & version & full;
+        if (full) s & value;
+        return s;
+    }
+
+    //! @brief Serialises the content from/to a given output stream (const overload).
+    template <typename S>
+    S& serialize(S& s) const {
+        s << version << full;
+        if (full) s << value;
+        return s;
+    }
+};
+
+
+//! @brief A value received in full by a `delta_nbr` call.
+template <typename T>
+struct delta_entry {
+    //! @brief The version of the value (negative if it has to be received again).
+    int version;
+    //! @brief The value.
+    T value;
+    //! @brief The last time the sender was heard.
+    times_t heard;
+};
+
+
+//! @brief The local state of a `delta_nbr` call, to be kept in the node storage.
+template <typename T>
+struct delta_memory {
+    //! @brief The last value shared, with its version (negative if none) and whether it was sent in full.
+    delta<T> sent{T{}, -1, true};
+    //! @brief The last value received in full from every device heard within the retention time.
+    std::unordered_map<device_t, delta_entry<T>> received;
+    //! @brief The number of markers received which could not be decoded.
+    size_t misses = 0;
+};
+
+
+//! @brief Default time for which the values received from devices no longer heard are kept.
+constexpr times_t delta_retain = 10;
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+
+
+/**
+ * @brief Shares the result of `op` on the field of values of neighbours through delta encoding, returning it.
+ *
+ * The result is the same as `nbr(CALL, init, op)`, but the value is sent in full only when some
+ * neighbour did not acknowledge its current version. The storage tag `S` of the node (of type
+ * `delta_memory<T>`) holds the state of the call, and has to be different for different calls.
+ * A marker can be decoded only if the last full value received from its sender has the same version,
+ * which is kept while the sender is heard within `retain` (which should exceed the time for which
+ * messages are retained). Otherwise, as for a device hearing another before being heard by it, the
+ * marker is counted as a miss and decoded as the outdated value held (or `init`), until the full
+ * value, which is sent as soon as the sender hears that it is not acknowledged.
+ */
+template <typename node_t, typename S, typename T, typename G, typename = common::if_signature<G, T(field<T>)>>
+T delta_nbr(ARGS, S, T const& init, G&& op, times_t retain = delta_retain) { CODE
+    delta_memory<T>& m = node.storage(S{});
+    times_t t = node.current_time();
+    // exchanges the versions held of the values of neighbours
+    nbr(CALL, field<int>(-1), [&](field<int> const& acks){
+        nbr(CALL, delta<T>{init, -1, true}, [&](field<delta<T>> const& d){
+            // decodes markers as the last full value received with the same version
+            field<T> x = map_hood([&](device_t j, delta<T> const& y){
+                if (y.version < 0) return init;
+                if (y.full) {
+                    m.received[j] = {y.version, y.value, t};
+                    return y.value;
+                }
+                auto it = m.received.find(j);
+                if (it == m.received.end()) {
+                    ++m.misses;
+                    return init;
+                }
+                it->second.heard = t;
+                // an outdated value is used until the full one is received
+                if (it->second.version != y.version) {
+                    ++m.misses;
+                    it->second.version = -1;
+                }
+                return it->second.value;
+            }, node.nbr_uid(), d);
+            // forgets devices not heard within the retention time
+            for (auto it = m.received.begin(); it != m.received.end(); )
+                if (t - it->second.heard > retain) it = m.received.erase(it);
+                else ++it;
+            T v = op(x);
+            if (m.sent.version < 0 or not (m.sent.value == v)) {
+                ++m.sent.version;
+                m.sent.value = std::move(v);
+            }
+            // sends in full if isolated, or if some neighbour did not acknowledge the current version
+            bool stale = fold_hood(CALL, [](bool x, bool y){
+                return x or y;
+            }, map_hood([&](int a){
+                return a != m.sent.version;
+            }, acks), false);
+            bool isolated = fold_hood(CALL, [](bool x, bool y){
+                return x and y;
+            }, map_hood([](int){
+                return false;
+            }, acks), true);
+            m.sent.full = stale or isolated;
+            return m.sent;
+        });
+        // echoes the versions held (a version different from the marker forces a full value)
+        return map_hood([&](device_t j){
+            auto it = m.received.find(j);
+            return it == m.received.end() ? -1 : it->second.version;
+        }, node.nbr_uid());
+    });
+    return m.sent.value;
+}
+
+/**
+ * @brief Shares a value with neighbours through delta encoding, returning the field of their values.
+ *
+ * The result is the same as `nbr(CALL, init, value)`, with the encoding and state of the other form.
+ */
+template <typename node_t, typename S, typename T>
+field<T> delta_nbr(ARGS, S, T const& init, T const& value, times_t retain = delta_retain) { CODE
+    field<T> r(init);
+    delta_nbr(CALL, S{}, init, [&](field<T> const& x){
+        r = x;
+        return value;
+    }, retain);
+    return r;
+}
+//! @brief Exports for the delta_nbr function.
+template <typename T>
+FUN_EXPORT delta_nbr_t = common::export_list<field<int>, delta<T>>;
+
+
+}
+
+
+}
+
+#endif // FCPP_DELTA_EXPORT_H_
@@ -0,0 +1,236 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file device_set.hpp
+ * @brief Compact set of device identifiers, with fast union and serialisation.
+ */
+
+#ifndef FCPP_DEVICE_SET_H_
+#define FCPP_DEVICE_SET_H_
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "lib/settings.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+/**
+ * @brief Set of device identifiers, represented as a sorted list or as a bitset.
+ *
+ * The set is held in the cheapest of two forms: the sorted list of identifiers (for sparse sets),
+ * or the bitset words between the first and last non-zero word (for dense sets), so that small
+ * sets take a few bytes regardless of the identifiers in them. The form only depends on the content,
+ * and is switched as identifiers are inserted. Union and membership are word-level operations
+ * on bitsets, and merges or binary searches on lists. Sets are serialised in their form.
+ */
+class device_set {
+  public:
+    //! @brief Type of a bitset word.
+    using word_t = uint64_t;
+
+    //! @brief Empty constructor.
+    device_set() = default;
+
+    //! @brief Constructor from a list of identifiers.
+    device_set(std::initializer_list<device_t> l) {
+        for (device_t d : l) insert(d);
+    }
+
+    //! @brief Equality operator.
+    bool operator==(device_set const& o) const {
+        return m_size == o.m_size and m_offs == o.m_offs and m_ids == o.m_ids and m_words == o.m_words;
+    }
+
+    //! @brief Inequality operator.
+    bool operator!=(device_set const& o) const {
+        return not (*this == o);
+    }
+
+    //! @brief Whether the set is empty.
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    //! @brief Number of identifiers in the set.
+    size_t size() const {
+        return m_size;
+    }
+
+    //! @brief Whether the set is held as a bitset (otherwise, as a sorted list of identifiers).
+    bool dense() const {
+        return not m_words.empty();
+    }
+
+    //! @brief Number of occurrences of an identifier in the set (0 or 1).
+    size_t count(device_t d) const {
+        if (not dense()) return std::binary_search(m_ids.begin(), m_ids.end(), d) ? 1 : 0;
+        size_t i = d / bits;
+        if (i < m_offs or i >= m_offs + m_words.size()) return 0;
+        return (m_words[i - m_offs] >> (d % bits)) & 1;
+    }
+
+    //! @brief Inserts an identifier.
+    void insert(device_t d) {
+        if (dense()) set(d);
+        else {
+            auto it = std::lower_bound(m_ids.begin(), m_ids.end(), d);
+            if (it != m_ids.end() and *it == d) return;
+            m_ids.insert(it, d);
+            ++m_size;
+        }
+        normalize();
+    }
+
+    //! @brief Inserts every identifier of another set.
+    void insert(device_set const& o) {
+        if (not dense() and not o.dense()) {
+            std::vector<device_t> ids;
+            ids.reserve(m_ids.size() + o.m_ids.size());
+            std::set_union(m_ids.begin(), m_ids.end(), o.m_ids.begin(), o.m_ids.end(), std::back_inserter(ids));
+            m_ids = std::move(ids);
+            m_size = m_ids.size();
+        } else if (not dense()) {
+            device_set t = o;
+            for (device_t d : m_ids) t.set(d);
+            *this = std::move(t);
+        } else if (not o.dense()) {
+            for (device_t d : o.m_ids) set(d);
+        } else {
+            span(o.m_offs, o.m_offs + o.m_words.size() - 1);
+            for (size_t i = 0; i < o.m_words.size(); ++i) m_words[o.m_offs - m_offs + i] |= o.m_words[i];
+            m_size = 0;
+            for (word_t w : m_words) m_size += __builtin_popcountll(w);
+        }
+        normalize();
+    }
+
+    //! @brief Set union.
+    device_set& operator|=(device_set const& o) {
+        insert(o);
+        return *this;
+    }
+
+    //! @brief Calls `f(d)` for every identifier `d` in the set, in increasing order.
+    template <typename F>
+    void for_each(F&& f) const {
+        for (device_t d : m_ids) f(d);
+        for (size_t i = 0; i < m_words.size(); ++i)
+            for (word_t w = m_words[i]; w; w &= w-1)
+                f(device_t((m_offs + i) * bits + __builtin_ctzll(w)));
+    }
+
+    //! @brief Deserialises the content from a given input stream.
+    template <typename S>
+    auto serialize(S& s) -> decltype(s >> std::declval<bool&>(), s) {
+        bool sparse;
+        s >> sparse;
+        m_ids.clear();
+        m_words.clear();
+        m_offs = 0;
+        if (sparse) {
+            s >> m_ids;
+            std::sort(m_ids.begin(), m_ids.end());
+            m_ids.erase(std::unique(m_ids.begin(), m_ids.end()), m_ids.end());
+            m_size = m_ids.size();
+        } else {
+            s >> m_offs >> m_words;
+            // trims zero words at both ends
+            size_t first = 0;
+            while (first < m_words.size() and m_words[first] == 0) ++first;
+            while (m_words.size() > first and m_words.back() == 0) m_words.pop_back();
+            m_words.erase(m_words.begin(), m_words.begin() + first);
+            m_offs = m_words.empty() ? 0 : m_offs + first;
+            m_size = 0;
+            for (word_t w : m_words) m_size += __builtin_popcountll(w);
+        }
+        normalize();
+        return s;
+    }
+
+    //! @brief Serialises the content to a given output stream (through the const overload).
+    template <typename S>
+    auto serialize(S& s) -> decltype(s << true, s) {
+        return static_cast<device_set const&>(*this).serialize(s);
+    }
+
+    //! @brief Serialises the content to a given output stream (const overload).
+    template <typename S>
+    S& serialize(S& s) const {
+        s << not dense();
+        if (not dense()) return s << m_ids;
+        return s << m_offs << m_words;
+    }
+
+  private:
+    //! @brief Number of bits in a word.
+    static constexpr size_t bits = sizeof(word_t) * CHAR_BIT;
+
+    //! @brief Extends the bitset to cover the words from `lo` to `hi` (included).
+    void span(size_t lo, size_t hi) {
+        if (m_words.empty()) {
+            m_offs = lo;
+            m_words.assign(hi - lo + 1, 0);
+            return;
+        }
+        if (lo < m_offs) {
+            m_words.insert(m_words.begin(), m_offs - lo, 0);
+            m_offs = lo;
+        }
+        if (hi >= m_offs + m_words.size()) m_words.resize(hi - m_offs + 1, 0);
+    }
+
+    //! @brief Sets the bit of an identifier in the bitset.
+    void set(device_t d) {
+        size_t i = d / bits;
+        span(i, i);
+        word_t& w = m_words[i - m_offs];
+        word_t b = word_t(1) << (d % bits);
+        if (w & b) return;
+        w |= b;
+        ++m_size;
+    }
+
+    //! @brief Switches to the cheapest form for the current content.
+    void normalize() {
+        if (dense()) {
+            if (m_size * sizeof(device_t) >= m_words.size() * sizeof(word_t)) return;
+            std::vector<device_t> ids;
+            ids.reserve(m_size);
+            for_each([&](device_t d){
+                ids.push_back(d);
+            });
+            m_words.clear();
+            m_offs = 0;
+            m_ids = std::move(ids);
+        } else if (m_size > 0 and m_size * sizeof(device_t) >= (m_ids.back() / bits - m_ids.front() / bits + 1) * sizeof(word_t)) {
+            std::vector<device_t> ids = std::move(m_ids);
+            m_ids.clear();
+            m_size = 0;
+            for (device_t d : ids) set(d);
+        }
+    }
+
+    //! @brief The sorted identifiers (if the set is sparse).
+    std::vector<device_t> m_ids;
+    //! @brief The bitset words, without zero words at both ends (if the set is dense).
+    std::vector<word_t> m_words;
+    //! @brief The index of the first bitset word.
+    size_t m_offs = 0;
+    //! @brief Number of identifiers in the set.
+    size_t m_size = 0;
+};
+
+}
+
+#endif // FCPP_DEVICE_SET_H_
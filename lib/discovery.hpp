@@ -0,0 +1,150 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file discovery.hpp
+ * @brief Measurement of the neighbour discovery performed by the connector of a simulation.
+ *
+ * The `connect::discovery<C>` connector behaves as the connector `C` of a simulation, while counting
+ * the candidate pairs of devices tested for connection and the time spent in testing them.
+ * Time is measured on one test every `connect::discovery_sample`, so that the clock is read in
+ * batches rather than twice per test. The simulators already index devices in cells as large as
+ * the connection radius, so that only pairs in nearby cells are tested: the counters measure how
+ * this discovery scales with the network.
+ */
+
+#ifndef FCPP_DISCOVERY_H_
+#define FCPP_DISCOVERY_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "lib/settings.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing connection predicates.
+namespace connect {
+
+
+//! @brief Number of tests for connection among which one is timed by `discovery` connectors.
+constexpr uint64_t discovery_sample = 64;
+
+//! @brief Work of neighbour discovery measured by `discovery` connectors.
+struct discovery_counters {
+    //! @brief Candidate pairs tested for connection.
+    uint64_t tests = 0;
+    //! @brief Pairs found connected.
+    uint64_t links = 0;
+    //! @brief Estimated seconds spent in testing (timed tests, scaled by the sample).
+    double seconds = 0;
+};
+
+//! @brief The registry of the counters of every thread.
+class discovery_registry {
+  public:
+    //! @brief Accesses the singleton.
+    static discovery_registry& get() {
+        static discovery_registry r;
+        return r;
+    }
+
+    //! @brief The counters of the current thread.
+    discovery_counters& local() {
+        thread_local std::shared_ptr<discovery_counters> c = attach();
+        return *c;
+    }
+
+    //! @brief The counters merged across threads (to be called when no simulation is running).
+    discovery_counters totals() {
+        std::lock_guard<std::mutex> l(m_mutex);
+        discovery_counters t;
+        for (auto const& c : m_counters) {
+            t.tests += c->tests;
+            t.links += c->links;
+            t.seconds += c->seconds;
+        }
+        return t;
+    }
+
+    //! @brief Clears the counters of every thread (to be called when no simulation is running).
+    void reset() {
+        std::lock_guard<std::mutex> l(m_mutex);
+        for (auto const& c : m_counters) *c = discovery_counters{};
+    }
+
+  private:
+    //! @brief Creates and registers the counters of a thread.
+    std::shared_ptr<discovery_counters> attach() {
+        auto c = std::make_shared<discovery_counters>();
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_counters.push_back(c);
+        return c;
+    }
+
+    //! @brief The counters of every thread (kept after the thread exits).
+    std::vector<std::shared_ptr<discovery_counters>> m_counters;
+    //! @brief Guards the counters.
+    std::mutex m_mutex;
+};
+
+//! @brief Prints the work of neighbour discovery measured by `discovery` connectors.
+inline void discovery_report(std::ostream& o) {
+    discovery_counters t = discovery_registry::get().totals();
+    o << "neighbour discovery: " << t.tests << " pairs tested, " << t.links << " connected, " << t.seconds << "s estimated\n";
+}
+
+/**
+ * @brief Connector behaving as `C`, and measuring the neighbour discovery it performs.
+ *
+ * It can be used as `connector<connect::discovery<C>>` in place of `connector<C>`.
+ */
+template <typename C>
+class discovery : public C {
+  public:
+    using C::C;
+
+    //! @brief Checks whether connection is possible, measuring the test.
+    template <typename... Ts>
+    bool operator()(Ts&&... xs) {
+        return tested(static_cast<C&>(*this), std::forward<Ts>(xs)...);
+    }
+
+    //! @brief Checks whether connection is possible, measuring the test (const overload).
+    template <typename... Ts>
+    bool operator()(Ts&&... xs) const {
+        return tested(static_cast<C const&>(*this), std::forward<Ts>(xs)...);
+    }
+
+  private:
+    //! @brief Performs a test through a connector, counting it (and timing one test every sample).
+    template <typename D, typename... Ts>
+    static bool tested(D& c, Ts&&... xs) {
+        discovery_counters& k = discovery_registry::get().local();
+        bool r;
+        if (k.tests++ % discovery_sample == 0) {
+            auto start = std::chrono::steady_clock::now();
+            r = c(std::forward<Ts>(xs)...);
+            k.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * discovery_sample;
+        } else r = c(std::forward<Ts>(xs)...);
+        k.links += r;
+        return r;
+    }
+};
+
+
+}
+
+
+}
+
+#endif // FCPP_DISCOVERY_H_
@@ -0,0 +1,237 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file dispatch.hpp
+ * @brief Aggregate processes dispatching point-to-point messages along the paths of a spanning tree.
+ *
+ * Messages are dispatched either through a process per message (`single_dispatch`), or through a
+ * process per receiver and time window carrying a queue of messages (`batched_dispatch`). Both take
+ * the set of devices below the current one in a spanning tree, and run a process only on devices
+ * below its sender or receiver.
+ */
+
+#ifndef FCPP_DISPATCH_H_
+#define FCPP_DISPATCH_H_
+
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+#include "lib/coordination.hpp"
+#include "lib/data.hpp"
+
+#include "lib/device_set.hpp"
+#include "lib/export_size.hpp"
+
+
+//! @brief Struct representing a message.
+struct message {
+    //! @brief Sender UID.
+    fcpp::device_t from;
+    //! @brief Receiver UID.
+    fcpp::device_t to;
+    //! @brief Creation timestamp.
+    fcpp::times_t time;
+
+    //! @brief Empty constructor.
+    message() = default;
+
+    //! @brief Member constructor.
+    message(fcpp::device_t from, fcpp::device_t to, fcpp::times_t time) : from(from), to(to), time(time) {}
+
+    //! @brief Equality operator.
+    bool operator==(message const& m) const {
+        return from == m.from and to == m.to and time == m.time;
+    }
+
+    //! @brief Ordering operator (by time, sender and receiver).
+    bool operator<(message const& m) const {
+        if (time != m.time) return time < m.time;
+        if (from != m.from) return from < m.from;
+        return to < m.to;
+    }
+
+    //! @brief Hash computation.
+    size_t hash() const {
+        constexpr size_t offs = sizeof(size_t)*CHAR_BIT/3;
+        return (size_t(time) << (2*offs)) | (size_t(from) << (offs)) | size_t(to);
+    }
+
+    //! @brief Serialises the content from/to a given input/output stream.
+    template <typename S>
+    S& serialize(S& s) {
+        return s & from & to & time;
+    }
+
+    //! @brief Serialises the content from/to a given input/output stream (const overload).
+    template <typename S>
+    S& serialize(S& s) const {
+        return s << from << to << time;
+    }
+};
+
+
+//! @brief Struct representing a batch of messages to the same receiver, sent in the same time window.
+struct batch {
+    //! @brief Receiver UID.
+    fcpp::device_t to;
+    //! @brief Index of the time window.
+    int window;
+
+    //! @brief Empty constructor.
+    batch() = default;
+
+    //! @brief Member constructor.
+    batch(fcpp::device_t to, int window) : to(to), window(window) {}
+
+    //! @brief Equality operator.
+    bool operator==(batch const& b) const {
+        return to == b.to and window == b.window;
+    }
+
+    //! @brief Hash computation.
+    size_t hash() const {
+        constexpr size_t offs = sizeof(size_t)*CHAR_BIT/2;
+        return (size_t(window) << offs) | size_t(to);
+    }
+
+    //! @brief Serialises the content from/to a given input/output stream.
+    template <typename S>
+    S& serialize(S& s) {
+        return s & to & window;
+    }
+
+    //! @brief Serialises the content from/to a given input/output stream (const overload).
+    template <typename S>
+    S& serialize(S& s) const {
+        return s << to << window;
+    }
+};
+
+
+namespace std {
+    //! @brief Hasher object for the message struct.
+    template <>
+    struct hash<message> {
+        //! @brief Produces an hash for a message, combining to and from into a size_t.
+        size_t operator()(message const& m) const {
+            return m.hash();
+        }
+    };
+
+    //! @brief Hasher object for the batch struct.
+    template <>
+    struct hash<batch> {
+        //! @brief Produces an hash for a batch, combining receiver and window into a size_t.
+        size_t operator()(batch const& b) const {
+            return b.hash();
+        }
+    };
+}
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Time window in which messages to the same receiver share a process (in batched mode).
+constexpr times_t batch_window = 5;
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+
+
+namespace tags {
+    //! @brief Total bytes exported by the message dispatching processes.
+    struct process_bytes {};
+}
+
+
+//! @brief Shorthand for a set of devices.
+using set_t = device_set;
+//! @brief Shorthand for a map associating times to messages.
+using map_t = std::unordered_map<message, times_t>;
+//! @brief Shorthand for a sorted queue of messages.
+using queue_t = std::vector<message>;
+
+//! @brief Merges two sorted queues of messages.
+inline queue_t merge_queues(queue_t const& x, queue_t const& y) {
+    queue_t q;
+    q.reserve(x.size() + y.size());
+    std::set_union(x.begin(), x.end(), y.begin(), y.end(), std::back_inserter(q));
+    return q;
+}
+
+//! @brief Dispatches every message through its own process, returning the messages delivered with their times.
+FUN map_t single_dispatch(ARGS, set_t const& below, common::option<message> const& m, std::vector<color>& procs) { CODE
+    using namespace tags;
+    return spawn(CALL, [&](message const& m){
+        procs.push_back(color::hsva(m.to*360.0/node.net.node_size(), 1, 1));
+        bool inpath = below.count(m.from) + below.count(m.to) > 0;
+        status s = node.uid == m.to ? status::terminated_output :
+                   inpath ? status::internal : status::external;
+        attribute_bytes(CALL, process_bytes{}, m, s);
+        return make_tuple(node.current_time(), s);
+    }, m);
+}
+//! @brief Exports for the single_dispatch function.
+FUN_EXPORT single_dispatch_t = export_list<spawn_t<message, status>>;
+
+/**
+ * @brief Dispatches messages through one process per receiver and time window, returning the messages delivered with their times.
+ *
+ * Every process carries the queue of its messages, gathered from the neighbours. A device is in
+ * the path of a process if it is in the path of any of its messages (with the same condition
+ * as in `single_dispatch`). The receiver delivers the messages as they reach it, and terminates
+ * the process only after its window closed and no message reached it for another window, so that
+ * messages sent in the window after a first delivery are not lost.
+ */
+FUN map_t batched_dispatch(ARGS, set_t const& below, common::option<message> const& m, std::vector<color>& procs) { CODE
+    using namespace tags;
+    common::option<batch> k;
+    for (message const& x : m) k.emplace(x.to, int(x.time / batch_window));
+    std::unordered_map<batch, queue_t> r = spawn(CALL, [&](batch const& b){
+        procs.push_back(color::hsva(b.to*360.0/node.net.node_size(), 1, 1));
+        queue_t own;
+        for (message const& x : m) if (x.to == b.to and int(x.time / batch_window) == b.window) own.push_back(x);
+        queue_t q = nbr(CALL, queue_t{}, [&](field<queue_t> const& n){
+            return fold_hood(CALL, [](queue_t const& x, queue_t const& y){
+                return merge_queues(x, y);
+            }, n, own);
+        });
+        bool inpath = below.count(b.to) > 0;
+        for (message const& x : q) inpath = inpath or below.count(x.from) > 0;
+        status s = inpath ? status::internal : status::external;
+        queue_t fresh;
+        if (node.uid == b.to) {
+            // the messages delivered so far, and the time of the last delivery
+            tuple<queue_t, times_t> d = old(CALL, make_tuple(queue_t{}, node.current_time()), [&](tuple<queue_t, times_t> d){
+                std::set_difference(q.begin(), q.end(), get<0>(d).begin(), get<0>(d).end(), std::back_inserter(fresh));
+                if (fresh.size()) d = make_tuple(merge_queues(get<0>(d), fresh), node.current_time());
+                return d;
+            });
+            bool closed = node.current_time() >= (b.window + 1) * batch_window and node.current_time() >= get<1>(d) + batch_window;
+            s = closed ? status::terminated_output : status::internal_output;
+        }
+        attribute_bytes(CALL, process_bytes{}, b, q, s);
+        return make_tuple(fresh, s);
+    }, k);
+    map_t d;
+    for (auto const& x : r) for (message const& y : x.second) d[y] = node.current_time();
+    return d;
+}
+//! @brief Exports for the batched_dispatch function.
+FUN_EXPORT batched_dispatch_t = export_list<spawn_t<batch, status>, queue_t, tuple<queue_t, times_t>>;
+
+
+}
+
+
+}
+
+#endif // FCPP_DISPATCH_H_
@@ -0,0 +1,272 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file export_size.hpp
+ * @brief Attribution of exported bytes to the functions of an aggregate program.
+ *
+ * Attribution is enabled by compiling with `FCPP_EXPORT_SIZE=1`, otherwise `attribute_bytes` and
+ * `attribute_remainder` do nothing (and the values are not serialised). When enabled, every call
+ * `attribute_bytes(CALL, S{}, xs...)` measures the serialised size of the values `xs` exported by
+ * a function. The bytes attributed in a round are held in `node.storage(coordination::tags::attributed_bytes{})`,
+ * which has to be in the node storage with type `attribution::ledger`, and are settled by a call
+ * `attribute_remainder(node, O{})` at the start of the following round, once the size of the message
+ * carrying them is known:
+ * - the bytes are added into `node.storage(S{})` for every tag `S` (so that they can be logged through
+ *   aggregators and plotted as any other value of a round) and counted per tag and calling trace into
+ *   per-thread tables (which can be printed after the simulation through `attribution::report`);
+ * - the bytes of the message which were not attributed (trace keys, framing and unlisted exports)
+ *   are added into `node.storage(O{})`, so that the parts sum to `node.msg_size()`.
+ *
+ * The serialised values may exceed the message actually sent (e.g. with `export_split<true>`, where
+ * fields are sent to every neighbour with its own value only). The attributed bytes are then scaled
+ * down proportionally to fit the message size, with a warning on the first occurrence, and the
+ * rounds scaled are counted in the report.
+ */
+
+#ifndef FCPP_EXPORT_SIZE_H_
+#define FCPP_EXPORT_SIZE_H_
+
+#ifndef FCPP_EXPORT_SIZE
+//! @brief Whether attribution of exported bytes is enabled.
+#define FCPP_EXPORT_SIZE 0
+#endif
+
+#if FCPP_EXPORT_SIZE
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#endif
+
+#include "lib/settings.hpp"
+#include "lib/common/serialize.hpp"
+#include "lib/common/tagged_tuple.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+    namespace tags {
+        //! @brief Bytes attributed to functions in the current round (with `FCPP_EXPORT_SIZE=1`).
+        struct attributed_bytes {};
+    }
+}
+
+
+//! @brief Serialised size of a value, as it appears in exports.
+template <typename T>
+size_t export_size(T const& x) {
+    common::osstream s;
+    s << x;
+    return s.size();
+}
+
+//! @brief Serialised size of a sequence of values, as they appear in exports.
+template <typename T, typename... Ts>
+size_t export_size(T const& x, Ts const&... xs) {
+    return export_size(x) + export_size(xs...);
+}
+
+
+//! @brief Namespace containing the attribution of exported bytes.
+namespace attribution {
+
+
+#if FCPP_EXPORT_SIZE
+
+//! @brief Table of bytes by tag index and calling trace.
+using table = std::map<std::pair<size_t, trace_t>, size_t>;
+
+//! @brief The registry of attributed tags and of the tables of every thread.
+class registry {
+  public:
+    //! @brief Accesses the singleton.
+    static registry& get() {
+        static registry r;
+        return r;
+    }
+
+    //! @brief Registers a name, returning its index.
+    size_t key(std::string const& name) {
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_names.push_back(name);
+        return m_names.size() - 1;
+    }
+
+    //! @brief The table of the current thread.
+    table& local() {
+        thread_local std::shared_ptr<table> t = attach();
+        return *t;
+    }
+
+    //! @brief Prints the tables merged across threads (to be called when no thread is attributing).
+    void report(std::ostream& o) {
+        std::lock_guard<std::mutex> l(m_mutex);
+        table m;
+        size_t tot = 0;
+        for (auto const& t : m_tables)
+            for (auto const& x : *t) m[x.first] += x.second;
+        for (auto const& x : m) {
+            o << m_names[x.first.first] << "@" << x.first.second << ": " << x.second << "\n";
+            tot += x.second;
+        }
+        o << "total: " << tot << "\n";
+        if (m_scaled > 0) o << "rounds scaled to the message size: " << m_scaled << "\n";
+    }
+
+    //! @brief Counts a round whose attributed bytes were scaled to the message size, returning whether it is the first.
+    bool scaled() {
+        return m_scaled++ == 0;
+    }
+
+  private:
+    //! @brief Creates and registers the table of a thread.
+    std::shared_ptr<table> attach() {
+        auto t = std::make_shared<table>();
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_tables.push_back(t);
+        return t;
+    }
+
+    //! @brief The registered names.
+    std::vector<std::string> m_names;
+    //! @brief The tables of every thread (kept after the thread exits).
+    std::vector<std::shared_ptr<table>> m_tables;
+    //! @brief Guards the names and tables.
+    std::mutex m_mutex;
+    //! @brief The number of rounds whose attributed bytes were scaled to the message size.
+    std::atomic<size_t> m_scaled{0};
+};
+
+//! @brief Index of a tag in the registry.
+template <typename S>
+size_t key() {
+    static size_t const k = registry::get().key(common::details::strip_namespaces(common::type_name<S>()));
+    return k;
+}
+
+//! @brief Prints the bytes attributed to every tag and trace, merged across threads.
+inline void report(std::ostream& o) {
+    registry::get().report(o);
+}
+
+//! @brief The bytes attributed by a node in a round, waiting to be settled against the message size.
+class ledger {
+  public:
+    //! @brief Records bytes attributed to the storage tag `S` of a node at a calling trace.
+    template <typename node_t, typename S>
+    void add(S, trace_t call_point, size_t b) {
+        m_entries.emplace_back(&add_to<node_t, S>, key<S>(), call_point, b);
+        m_total += b;
+    }
+
+    //! @brief Settles the recorded bytes into a node given its message size, returning the bytes not attributed.
+    template <typename node_t>
+    size_t settle(node_t& node, size_t msg_size) {
+        bool over = m_total > msg_size;
+        if (over and registry::get().scaled())
+            std::cerr << "warning: bytes attributed to functions (" << m_total << ") exceed the message size (" << msg_size << "), scaling them down" << std::endl;
+        size_t r = msg_size;
+        table& t = registry::get().local();
+        for (auto const& e : m_entries) {
+            size_t b = over ? std::get<3>(e) * msg_size / m_total : std::get<3>(e);
+            std::get<0>(e)(&node, b);
+            t[{std::get<1>(e), std::get<2>(e)}] += b;
+            r -= b;
+        }
+        m_entries.clear();
+        m_total = 0;
+        return r;
+    }
+
+    //! @brief The total bytes recorded.
+    size_t total() const {
+        return m_total;
+    }
+
+  private:
+    //! @brief Adds bytes into the storage tag `S` of a node.
+    template <typename node_t, typename S>
+    static void add_to(void* node, size_t b) {
+        static_cast<node_t*>(node)->storage(S{}) += b;
+    }
+
+    //! @brief The recorded bytes, with the function adding them to the node storage, the tag index and the calling trace.
+    std::vector<std::tuple<void(*)(void*, size_t), size_t, trace_t, size_t>> m_entries;
+    //! @brief The total bytes recorded.
+    size_t m_total = 0;
+};
+
+#else
+
+//! @brief The bytes attributed by a node in a round (disabled).
+struct ledger {
+    //! @brief The total bytes recorded.
+    size_t total() const {
+        return 0;
+    }
+};
+
+//! @brief Prints the bytes attributed to every tag and trace, merged across threads (disabled).
+template <typename O>
+void report(O&) {}
+
+#endif
+
+//! @brief Prints the total bytes of a ledger.
+template <typename O>
+O& operator<<(O& o, ledger const& l) {
+    return o << l.total();
+}
+
+
+}
+
+
+/**
+ * @brief Attributes the serialised size of some values to the storage tag `S` of a node.
+ *
+ * The values should be exactly those exported by the function at the calling trace.
+ */
+template <typename node_t, typename S, typename... Ts>
+void attribute_bytes(node_t& node, trace_t call_point, S, Ts const&... xs) {
+#if FCPP_EXPORT_SIZE
+    node.storage(coordination::tags::attributed_bytes{}).template add<node_t>(S{}, call_point, export_size(xs...));
+#else
+    int unused[] = {0, ((void)xs, 0)...};
+    (void)unused; (void)node; (void)call_point;
+#endif
+}
+
+/**
+ * @brief Settles the bytes attributed in the previous round against the size of its message.
+ *
+ * The bytes not attributed to any function are added to the storage tag `O` of a node, and
+ * the attributed ones are scaled down to the message size if they exceed it.
+ */
+template <typename node_t, typename O>
+void attribute_remainder(node_t& node, O) {
+#if FCPP_EXPORT_SIZE
+    size_t b = node.storage(coordination::tags::attributed_bytes{}).settle(node, node.msg_size());
+    node.storage(O{}) += b;
+    attribution::registry::get().local()[{attribution::key<O>(), trace_t{}}] += b;
+#else
+    (void)node;
+#endif
+}
+
+
+}
+
+#endif // FCPP_EXPORT_SIZE_H_
@@ -0,0 +1,64 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file handover.hpp
+ * @brief Distances from sources switching on a fixed schedule, warming up the next source ahead of handovers.
+ *
+ * The source of window `w` (of length `step`) is the device with identifier `w`. Sources of even
+ * and odd windows alternate between two gradients, so that the gradient of the next source can
+ * be computed from `lead` time units before the handover, alongside the gradient of the current
+ * source: it has already converged when the source switches, and the gradient of the past source
+ * is then dropped.
+ */
+
+#ifndef FCPP_HANDOVER_H_
+#define FCPP_HANDOVER_H_
+
+#include "lib/coordination.hpp"
+#include "lib/data.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+
+
+/**
+ * @brief Distances from the current source and from the next one (infinite until `lead` time units before the handover).
+ *
+ * The source of the current time window of length `step` is the device whose identifier is the index of the window.
+ */
+FUN tuple<double, double> handover_distances(ARGS, int step, times_t lead) { CODE
+    times_t t = node.current_time();
+    device_t window = int(t) / step;
+    bool upcoming = t >= (window + 1) * step - lead;
+    // the source of each gradient among the current and next ones
+    device_t even = window % 2 == 0 ? window : window + 1;
+    device_t odd  = window % 2 == 1 ? window : window + 1;
+    double d[2] = {INF, INF};
+    if (window % 2 == 0 or upcoming) d[0] = abf_distance(CALL, node.uid == even);
+    if (window % 2 == 1 or upcoming) d[1] = abf_distance(CALL, node.uid == odd);
+    return make_tuple(d[window % 2], d[1 - window % 2]);
+}
+//! @brief Export types used by the handover_distances function.
+FUN_EXPORT handover_distances_t = common::export_list<abf_distance_t>;
+
+//! @brief Distance from the current source, computed by `handover_distances`.
+FUN double handover_distance(ARGS, int step, times_t lead) { CODE
+    return get<0>(handover_distances(CALL, step, lead));
+}
+//! @brief Export types used by the handover_distance function.
+FUN_EXPORT handover_distance_t = common::export_list<handover_distances_t>;
+
+
+}
+
+
+}
+
+#endif // FCPP_HANDOVER_H_
@@ -17,7 +17,8 @@
 
 #include "lib/fcpp.hpp"
 
- #define printer(v) std::cerr << #v << " = " << v << std::endl
+#include "lib/snapshot.hpp"
+#include "lib/trace.hpp"
 
 
 
@@ -61,6 +62,8 @@ namespace coordination {
 namespace tags {
     //! @brief The device movement speed.
     struct speed {};
+    //! @brief Side of the square area walked by devices (set at initialisation, so that it can scale with the network).
+    struct area_side {};
     //! @brief True distance of the current node from the source.
     struct true_distance {};
     //! @brief Computed distance of the current node from the source.
@@ -91,10 +94,11 @@ FUN bool select_source(ARGS, int step) { CODE
     // the source ID increases by 1 every "step" seconds
     device_t source_id = ((int)node.current_time()) / step;
     bool is_source = node.uid == source_id;
-    // retrieves from the net object the current true position of the source
-    vec<3> source_pos = node.position();
-    if (node.net.node_count(source_id))
-        source_pos = node.net.node_at(source_id).position(node.current_time());
+    // retrieves the position of the source, extrapolated from its state at its last round (exactly, as it moves at constant velocity between rounds)
+    snapshot::device_state<3> source = snapshot::selected_state<3>(node, [step](times_t t){
+        return device_t(int(t) / step);
+    });
+    vec<3> source_pos = source.present ? source.position_at(node.current_time()) : node.position();
     // store relevant values in the node storage
     node.storage(tags::true_distance{})     = distance(node.position(), source_pos);
     node.storage(tags::node_size{})         = is_source ? 20 : 10;
@@ -139,7 +143,7 @@ T list_arith_collection(node_t& node, trace_t call_point, real_t const& distance
     field<real_t> maxDistNow = node.nbr_dist() + speed * node.nbr_lag();
     field<real_t> Vwst = mux(isfinite(distance) and maxDistNow < radius, (distance - Pu) / (Tu - t), (real_t)(-INF));
     field<real_t> nbrThreshold = nbr(node, 3, max_hood(node, 0, Vwst, 0));
-    std::cerr << "ROUND " << t << " NODE " << node.uid << std::endl;
+    TRACE_MARK("ROUND");
     //nbr(node,0,nbrThreshold)
     return nbr(node, 0, value, [&](field<T> x){
 
@@ -158,20 +162,20 @@ T list_arith_collection(node_t& node, trace_t call_point, real_t const& distance
         //bool tresholdEquals = get<0>(max_hood(node, 0, nbr(node,2,make_tuple(Vwst,node.uid)))) == nbrThreshold;
 
         
-        printer(nbrdist);
-        printer(Tu);
-        printer(t);
-        printer(distance);
-        printer(nbr_uid(node, parent));
-
-        printer(node.uid);
-        printer(Vwst);
-        printer(parent);
-        printer(x);
+        TRACE_VALUE(nbrdist);
+        TRACE_VALUE(Tu);
+        TRACE_VALUE(t);
+        TRACE_VALUE(distance);
+        TRACE_VALUE(nbr_uid(node, parent));
+
+        TRACE_VALUE(node.uid);
+        TRACE_VALUE(Vwst);
+        TRACE_VALUE(parent);
+        TRACE_VALUE(x);
         
-        //printer(tresholdEquals);
+        //TRACE_VALUE(tresholdEquals);
 
-        //printer(res);
+        //TRACE_VALUE(res);
         
         
         //device_t parent = get<1>(min_hood( node, 0, mux(nbr(node, 4, max_hood(node, 0, Vwst, 0))==Vwst, make_tuple(nbrdist ,nbr_uid(node, 0)),make_tuple((-INF) ,-nbr_uid(node, 0)))));
@@ -194,7 +198,7 @@ FUN void prova(ARGS, bool is_source, device_t source_id, double dist) { CODE
     };
     
     double idec = list_arith_collection(CALL,dist,1.0,100.0,1.0,0.0,1.0,adder);
-    std::cerr << "============================" << std::endl;
+    TRACE_MARK("============================");
     //double idec = sp_collection(CALL, dist, 1.0, 0.0, adder);
     node.storage(tags::sum_tot{})           = idec;
 }
@@ -204,7 +208,8 @@ FUN_EXPORT prova_t = common::export_list<list_arith_collection_t<double>>;
 //! @brief Main function.
 MAIN() {
     // random walk into a given rectangle with given speed
-    rectangle_walk(CALL, make_vec(0,0,0), make_vec(side,side,height), node.storage(tags::speed{}), 1);
+    real_t s = node.storage(tags::area_side{});
+    rectangle_walk(CALL, make_vec(0,0,0), make_vec(s,s,height), node.storage(tags::speed{}), 1);
     // selects a different source every 50 simulated seconds
     device_t source_id = 0;
     //bool is_source = select_source(CALL, 50);
@@ -277,12 +282,17 @@ using log_s = sequence::periodic_n<1, 0, 1, end_time>;
 using spawn_s = sequence::multiple_n<devices, 0>;
 //! @brief The distribution of initial node positions (random in a given rectangle).
 using rectangle_d = distribution::rect_n<1, 0, 0, 0, side, side, height>;
+//! @brief The distribution of the side of the walked area (fixed).
+using area_d = distribution::constant_n<double, side>;
 //! @brief The distribution of node speeds (all equal to a fixed value).
 using speed_d = distribution::constant_i<double, speed>;
+//! @brief The distribution of the snapshot board (one for the whole network).
+using board_d = snapshot::shared_board<snapshot::device_state<3>>;
 //! @brief The contents of the node storage as tags and associated types.
 using store_t = tuple_store<
     node_color,         color,
     speed,              double,
+    area_side,          double,
     true_distance,      double,
     calc_distance,      double,
     source_diameter,    double,
@@ -292,9 +302,10 @@ using store_t = tuple_store<
     diameter_c,         color,
     node_shape,         shape,
     node_size,          double,
-    sum_tot,            double   
+    sum_tot,            double,
+    snapshot_board,     std::shared_ptr<snapshot::board<snapshot::device_state<3>>>
 >;
-//! @brief The tags and corresponding aggregators to be logged.
+//! @brief The tags and corresponding aggregators to be logged (true_distance is measured from the position of the source extrapolated from its last round, which is exact).
 using aggregator_t = aggregators<
     true_distance,      aggregator::max<double>,
     diameter,           aggregator::combine<
@@ -327,8 +338,10 @@ DECLARE_OPTIONS(list,
     store_t,       // the contents of the node storage
     aggregator_t,  // the tags and corresponding aggregators to be logged
     init<
-        x,      rectangle_d, // initialise position randomly in a rectangle for new nodes
-        speed,  speed_d      // initialise speed with the globally provided speed for new nodes
+        x,              rectangle_d, // initialise position randomly in a rectangle for new nodes
+        speed,          speed_d,     // initialise speed with the globally provided speed for new nodes
+        area_side,      area_d,      // walk in the whole deployment area
+        snapshot_board, board_d      // share a single snapshot board in the network
     >,
     extra_info<speed, double>, // use the globally provided speed for plotting
     plot_type<plot_t>,         // the plot description to be used
@@ -12,57 +12,11 @@
 #include "lib/coordination.hpp"
 #include "lib/data.hpp"
 
-
-//! @brief Struct representing a message.
-struct message {
-    //! @brief Sender UID.
-    fcpp::device_t from;
-    //! @brief Receiver UID.
-    fcpp::device_t to;
-    //! @brief Creation timestamp.
-    fcpp::times_t time;
-
-    //! @brief Empty constructor.
-    message() = default;
-
-    //! @brief Member constructor.
-    message(fcpp::device_t from, fcpp::device_t to, fcpp::times_t time) : from(from), to(to), time(time) {}
-
-    //! @brief Equality operator.
-    bool operator==(message const& m) const {
-        return from == m.from and to == m.to and time == m.time;
-    }
-
-    //! @brief Hash computation.
-    size_t hash() const {
-        constexpr size_t offs = sizeof(size_t)*CHAR_BIT/3;
-        return (size_t(time) << (2*offs)) | (size_t(from) << (offs)) | size_t(to);
-    }
-
-    //! @brief Serialises the content from/to a given input/output stream.
-    template <typename S>
-    S& serialize(S& s) {
-        return s & from & to & time;
-    }
-
-    //! @brief Serialises the content from/to a given input/output stream (const overload).
-    template <typename S>
-    S& serialize(S& s) const {
-        return s << from << to << time;
-    }
-};
-
-
-namespace std {
-    //! @brief Hasher object for the message struct.
-    template <>
-    struct hash<message> {
-        //! @brief Produces an hash for a message, combining to and from into a size_t.
-        size_t operator()(message const& m) const {
-            return m.hash();
-        }
-    };
-}
+#include "lib/delta_export.hpp"
+#include "lib/dispatch.hpp"
+#include "lib/export_size.hpp"
+#include "lib/profile.hpp"
+#include "lib/windowed_map.hpp"
 
 
 /**
@@ -85,6 +39,9 @@ constexpr size_t discrete_sqrt(size_t n) {
 //! @brief Number of devices.
 constexpr size_t devices = 300;
 
+//! @brief Time after which delivered messages are forgotten.
+constexpr times_t delivery_window = 100;
+
 //! @brief Communication radius.
 constexpr size_t comm = 100;
 
@@ -106,6 +63,12 @@ namespace tags {
     //! @brief The movement speed of devices.
     struct speed {};
 
+    //! @brief Side of the square area walked by devices (set at initialisation, so that it can scale with the network).
+    struct area_side {};
+
+    //! @brief Whether messages to the same receiver are dispatched in batches.
+    struct batched {};
+
     //! @brief The maximum message size ever exchanged by the node.
     struct max_msg {};
 
@@ -130,6 +93,42 @@ namespace tags {
     //! @brief Total number of repeated deliveries.
     struct repeat_count {};
 
+    //! @brief Number of entries in the delivery log.
+    struct log_size {};
+
+    //! @brief Total bytes exported by the distance estimation.
+    struct distance_bytes {};
+
+    //! @brief Total bytes exported by the spanning tree and routing sets.
+    struct tree_bytes {};
+
+    //! @brief Total bytes exported by the delivery log.
+    struct log_bytes {};
+
+    //! @brief Total bytes exported and not attributed to functions (trace keys, framing, acknowledgements of delta encoding).
+    struct other_bytes {};
+
+    //! @brief State of the delta-encoded sharing of distances for the parent selection.
+    struct parent_memory {};
+
+    //! @brief State of the delta-encoded sharing of routing sets.
+    struct below_memory {};
+
+    //! @brief Cycles spent in the random walk (with `FCPP_PROFILE=1`).
+    struct walk_cycles {};
+
+    //! @brief Cycles spent in the distance estimation (with `FCPP_PROFILE=1`).
+    struct distance_cycles {};
+
+    //! @brief Cycles spent in the collection of routing sets (with `FCPP_PROFILE=1`).
+    struct tree_cycles {};
+
+    //! @brief Cycles spent in the message dispatching processes (with `FCPP_PROFILE=1`).
+    struct spawn_cycles {};
+
+    //! @brief Cycles spent updating the delivery log (with `FCPP_PROFILE=1`).
+    struct log_cycles {};
+
     //! @brief Distance to the central node.
     struct center_dist {};
 
@@ -149,48 +148,61 @@ namespace tags {
     struct node_shape {};
 }
 
-//! @brief Shorthand for a set of devices.
-using set_t = std::unordered_set<device_t>;
-//! @brief Shorthand for a map associating times to messages.
-using map_t = std::unordered_map<message, times_t>;
+//! @brief Shorthand for a log associating times to recently delivered messages.
+using log_t = windowed_map<message, times_t>;
+
+/**
+ * @brief Collects the routing sets along the tree of distances, returning the devices below the current one.
+ *
+ * Computes the same sets as `sp_collection(CALL, ds, set_t{node.uid}, set_t{}, ...)` through set union,
+ * but shares the distances and the sets (which seldom change once the tree is stable) through delta encoding.
+ */
+FUN set_t delta_collection(ARGS, double ds) { CODE
+    using namespace tags;
+    device_t parent = get<1>(min_hood(CALL, make_tuple(delta_nbr(CALL, parent_memory{}, ds, ds), node.nbr_uid())));
+    field<device_t> parents = nbr(CALL, parent);
+    return delta_nbr(CALL, below_memory{}, set_t{}, [&](field<set_t> const& x){
+        return fold_hood(CALL, [](set_t x, set_t const& y){
+            x.insert(y);
+            return x;
+        }, mux(parents == node.uid, x, set_t{}), set_t{node.uid});
+    });
+}
+//! @brief Exports for the delta_collection function.
+FUN_EXPORT delta_collection_t = export_list<delta_nbr_t<double>, device_t, delta_nbr_t<set_t>>;
 
 //! @brief Main function.
 MAIN() {
     // import tags for convenience
     using namespace tags;
+    // bytes of the previous message not attributed to functions
+    attribute_remainder(node, other_bytes{});
     // random walk
-    rectangle_walk(CALL, make_vec(0,0,0), make_vec(side,side,height), node.storage(speed{}), 1);
+    real_t s = node.storage(area_side{});
+    PROFILE(walk_cycles, rectangle_walk(CALL, make_vec(0,0,0), make_vec(s,s,height), node.storage(speed{}), 1));
     device_t src_id = 0;
     // distance estimation
     bool is_src = node.uid == src_id;
-    double ds = bis_distance(CALL, is_src, 1, 100);
+    double ds = PROFILE(distance_cycles, bis_distance(CALL, is_src, 1, 100));
+    attribute_bytes(CALL, distance_bytes{}, ds, node.current_time());
     // basic node rendering
     node.storage(center_dist{}) = ds;
     node.storage(node_color{}) = color::hsva(ds*hue_scale, 1, 1);
     node.storage(node_shape{}) = is_src ? shape::cube : shape::icosahedron;
     node.storage(node_size{}) = is_src ? 16 : 10;
-    // spanning tree definition
-    device_t parent = get<1>(min_hood(CALL, make_tuple(nbr(CALL, ds), node.nbr_uid())));
-    // routing sets along the tree
-    set_t below = sp_collection(CALL, ds, set_t{node.uid}, set_t{}, [](set_t x, set_t const& y){
-        x.insert(y.begin(), y.end());
-        return x;
-    });
-    // random message with 1% probability during time [10..50]
+    // routing sets along the spanning tree
+    set_t below = PROFILE(tree_cycles, delta_collection(CALL, ds));
+    // the collection shares the delta encodings of ds and below (their acknowledgements are left to the remainder)
+    attribute_bytes(CALL, tree_bytes{}, node.storage(parent_memory{}).sent, node.storage(below_memory{}).sent);
+    // random message with 1% probability during time [10..50], to any of the devices in the network
     common::option<message> m;
     if (node.current_time() > 10 and node.current_time() < 50 and node.next_real() < 0.01) {
-        m.emplace(node.uid, (device_t)node.next_int(devices-1), node.current_time());
+        m.emplace(node.uid, (device_t)node.next_int(node.net.node_size()-1), node.current_time());
         node.storage(sent_count{}) += 1;
     }
     // dispatches messages
     std::vector<color> procs{color(BLACK)};
-    map_t r = spawn(CALL, [&](message const& m){
-        procs.push_back(color::hsva(m.to*360.0/devices, 1, 1));
-        bool inpath = below.count(m.from) + below.count(m.to) > 0;
-        status s = node.uid == m.to ? status::terminated_output :
-                   inpath ? status::internal : status::external;
-        return make_tuple(node.current_time(), s);
-    }, m);
+    map_t r = PROFILE(spawn_cycles, node.storage(batched{}) ? batched_dispatch(CALL, below, m, procs) : single_dispatch(CALL, below, m, procs));
     // process and msg stats
     node.storage(max_proc{}) = max(node.storage(max_proc{}), procs.size() - 1);
     node.storage(tot_proc{}) += procs.size() - 1;
@@ -200,21 +212,24 @@ MAIN() {
     // additional node rendering
     node.storage(left_color{})  = procs[min(int(procs.size()), 2)-1];
     node.storage(right_color{}) = procs[min(int(procs.size()), 3)-1];
-    // persist received messages and delivery stats
-    r = old(CALL, map_t{}, [&](map_t m){
+    // persist recently received messages and delivery stats
+    log_t l = PROFILE(log_cycles, old(CALL, log_t{delivery_window}, [&](log_t l){
+        l.advance(node.current_time());
         for (auto const& x : r) {
-            if (m.count(x.first)) node.storage(repeat_count{}) += 1;
+            if (l.count(x.first)) node.storage(repeat_count{}) += 1;
             else {
                 node.storage(first_delivery{}) += x.second - x.first.time;
                 node.storage(delivery_count{}) += 1;
-                m[x.first] = x.second;
+                l.insert(x.first, x.second);
             }
         }
-        return m;
-    });
+        return l;
+    }));
+    node.storage(log_size{}) = l.size();
+    attribute_bytes(CALL, log_bytes{}, l);
 }
 //! @brief Exports for the main function.
-FUN_EXPORT main_t = export_list<rectangle_walk_t<3>, bis_distance_t, sp_collection_t<double, set_t>, device_t, spawn_t<message, status>, map_t>;
+FUN_EXPORT main_t = export_list<rectangle_walk_t<3>, bis_distance_t, delta_collection_t, single_dispatch_t, batched_dispatch_t, log_t>;
 
 
 }
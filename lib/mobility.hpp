@@ -0,0 +1,336 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file mobility.hpp
+ * @brief Batched random walk of the devices of a network, computed in structure-of-arrays form.
+ *
+ * The `batch_walk` function behaves as `rectangle_walk`: it sets the velocity of the calling
+ * device towards a random target in a rectangle, choosing a new target once the current one is
+ * reached, and returns the current target. Instead of updating every device separately, the
+ * positions reported by devices and their targets are kept in contiguous arrays by a
+ * `mobility::engine`, which renews the targets reached and recomputes the velocities of blocks
+ * of devices in a single pass once every `period`, in loops over plain arrays which the compiler
+ * can vectorise. A round then only has to report the actual position of its device and read
+ * back its velocity. Positions are only moved by the simulator: the engine does not integrate
+ * them, so that a pass computes velocities from the positions of the last rounds of devices.
+ * Rounds of devices in different blocks run concurrently without synchronising with each other.
+ *
+ * A program using `batch_walk` needs the storage tag `tags::walk_engine`
+ * of type `std::shared_ptr<mobility::engine<n>>`, initialised by the `mobility::shared_engine<n>`
+ * distribution, which creates a single engine per network seeded by the generator of the network.
+ */
+
+#ifndef FCPP_MOBILITY_H_
+#define FCPP_MOBILITY_H_
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "lib/common/tagged_tuple.hpp"
+#include "lib/coordination.hpp"
+#include "lib/data.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the batched mobility engine.
+namespace mobility {
+
+
+/**
+ * @brief Random walk of every device of a network in rectangles, stored as arrays of coordinates.
+ *
+ * Devices are identified by their (dense) unique identifiers, and are grouped into blocks of
+ * `block_size` consecutive identifiers, allocated on the first step of one of their devices.
+ * Every call to `step` performs a pass over the block of its device if the last multiple of the
+ * period was not reached before, records the actual position of the device, and reads back its
+ * velocity. Steps do not lock: the first step of a block in a period claims its pass, which waits
+ * for the steps in progress in the block to complete, while the other steps in the block wait for
+ * the pass to complete (steps in different blocks never wait for each other).
+ *
+ * @tparam n The dimensionality of the space.
+ */
+template <size_t n>
+class engine {
+  public:
+    //! @brief Type of a position.
+    using position_type = vec<n>;
+
+    //! @brief Number of consecutive devices sharing a pass.
+    static constexpr size_t block_size = 256;
+
+    //! @brief Constructor with a given seed for the random generators of devices, and the maximum number of devices.
+    engine(uint64_t seed, size_t capacity = size_t(1) << 22) : m_seed(seed), m_blocks((capacity + block_size - 1) / block_size) {
+        for (auto& b : m_blocks) b.store(nullptr, std::memory_order_relaxed);
+    }
+
+    //! @brief Deleted copy constructor.
+    engine(engine const&) = delete;
+
+    //! @brief Deleted copy assignment.
+    engine& operator=(engine const&) = delete;
+
+    //! @brief Destructor, releasing the blocks.
+    ~engine() {
+        for (auto& b : m_blocks) delete b.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Records the position of a device at time `t`, returning its current target.
+     *
+     * The velocity is updated to the one towards the target. The target is renewed if
+     * the device is new, or walks in a different rectangle than before.
+     */
+    position_type step(device_t d, times_t t, position_type const& p, position_type& v, position_type const& low, position_type const& hi, real_t max_v, real_t period) {
+        if (d / block_size >= m_blocks.size()) throw std::out_of_range("mobility engine: device identifier beyond capacity");
+        block& b = get_block(d / block_size);
+        size_t j = d % block_size;
+        int64_t e = std::floor(t / period);
+        while (true) {
+            int64_t done = b.epoch.load();
+            int64_t c = b.claimed.load();
+            if (done < e and c == done) {
+                // the period is new and no pass is in progress: the first step claims it
+                if (b.claimed.compare_exchange_strong(c, e)) {
+                    while (b.busy.load() > 0) std::this_thread::yield();
+                    b.advance(0, block_size, period);
+                    b.epoch.store(e);
+                }
+                continue;
+            }
+            if (done < e or c != done) {
+                // the pass is in progress
+                std::this_thread::yield();
+                continue;
+            }
+            b.busy.fetch_add(1);
+            if (b.claimed.load() == done) break;
+            // a pass was claimed in the meantime
+            b.busy.fetch_sub(1);
+        }
+        for (size_t i = 0; i < n; ++i) b.pos[i][j] = p[i];
+        b.speed[j] = max_v;
+        if (not b.active[j] or not b.same_rectangle(j, low, hi)) {
+            b.active[j] = true;
+            for (size_t i = 0; i < n; ++i) {
+                b.low[i][j] = low[i];
+                b.high[i][j] = hi[i];
+            }
+            b.retarget(j);
+            b.advance(j, j+1, period);
+        }
+        position_type target = v;
+        for (size_t i = 0; i < n; ++i) {
+            v[i] = b.vel[i][j];
+            target[i] = b.target[i][j];
+        }
+        b.busy.fetch_sub(1);
+        return target;
+    }
+
+    //! @brief Maximum number of devices.
+    size_t capacity() const {
+        return m_blocks.size() * block_size;
+    }
+
+  private:
+    //! @brief The arrays of a block of devices.
+    struct block {
+        //! @brief Constructor with the seed of the random generators of devices and the first device.
+        block(uint64_t seed, size_t first) {
+            for (size_t i = 0; i < n; ++i) {
+                pos[i].fill(0);
+                vel[i].fill(0);
+                target[i].fill(0);
+                low[i].fill(std::numeric_limits<real_t>::quiet_NaN());
+                high[i].fill(std::numeric_limits<real_t>::quiet_NaN());
+            }
+            speed.fill(0);
+            dist.fill(0);
+            for (size_t j = 0; j < block_size; ++j) state[j] = mix(seed + first + j);
+            active.fill(false);
+        }
+
+        //! @brief Whether a device walks in a given rectangle.
+        bool same_rectangle(size_t j, position_type const& l, position_type const& h) const {
+            for (size_t i = 0; i < n; ++i)
+                if (low[i][j] != l[i] or high[i][j] != h[i]) return false;
+            return true;
+        }
+
+        //! @brief Pseudo-random number in `[0,1)` from the generator of a device (splitmix64).
+        real_t uniform(size_t j) {
+            return (mix(state[j] += 0x9E3779B97F4A7C15ULL) >> 11) / 9007199254740992.0;
+        }
+
+        //! @brief Chooses a new random target for a device.
+        void retarget(size_t j) {
+            for (size_t i = 0; i < n; ++i)
+                target[i][j] = low[i][j] + (high[i][j] - low[i][j]) * uniform(j);
+        }
+
+        //! @brief Renews reached targets and recomputes velocities of devices in `[b,e)`, from their last reported positions.
+        void advance(size_t b, size_t e, real_t period) {
+            for (size_t j = b; j < e; ++j) dist[j] = 0;
+            for (size_t i = 0; i < n; ++i)
+                for (size_t j = b; j < e; ++j) dist[j] += (target[i][j] - pos[i][j]) * (target[i][j] - pos[i][j]);
+            // targets are reached rarely, so that renewing them is left out of the vectorised loops
+            for (size_t j = b; j < e; ++j) {
+                real_t reach = speed[j] * period;
+                if (active[j] and dist[j] <= reach * reach) {
+                    retarget(j);
+                    dist[j] = 0;
+                    for (size_t i = 0; i < n; ++i) dist[j] += (target[i][j] - pos[i][j]) * (target[i][j] - pos[i][j]);
+                }
+            }
+            // velocity towards the target: reaching it within a period, or at maximum speed
+            for (size_t j = b; j < e; ++j) {
+                real_t reach = speed[j] * period;
+                dist[j] = dist[j] <= reach * reach ? 1 / period : speed[j] / std::sqrt(dist[j]);
+            }
+            for (size_t i = 0; i < n; ++i)
+                for (size_t j = b; j < e; ++j) vel[i][j] = (target[i][j] - pos[i][j]) * dist[j];
+        }
+
+        //! @brief The last period whose pass completed.
+        std::atomic<int64_t> epoch{std::numeric_limits<int64_t>::min()};
+        //! @brief The last period whose pass was claimed (different from `epoch` while a pass is in progress).
+        std::atomic<int64_t> claimed{std::numeric_limits<int64_t>::min()};
+        //! @brief The number of steps in progress.
+        std::atomic<size_t> busy{0};
+        //! @brief Keeps the arrays written by steps off the cache line of the counters.
+        char padding[64];
+        //! @brief The coordinates of the last reported positions of devices.
+        std::array<std::array<real_t, block_size>, n> pos;
+        //! @brief The coordinates of the velocities of devices.
+        std::array<std::array<real_t, block_size>, n> vel;
+        //! @brief The coordinates of the targets of devices.
+        std::array<std::array<real_t, block_size>, n> target;
+        //! @brief The coordinates of the lower corner of the rectangles of devices.
+        std::array<std::array<real_t, block_size>, n> low;
+        //! @brief The coordinates of the upper corner of the rectangles of devices.
+        std::array<std::array<real_t, block_size>, n> high;
+        //! @brief The maximum speeds of devices.
+        std::array<real_t, block_size> speed;
+        //! @brief Scratch space for distances and scaling factors.
+        std::array<real_t, block_size> dist;
+        //! @brief The states of the random generators of devices.
+        std::array<uint64_t, block_size> state;
+        //! @brief Whether devices have been reported.
+        std::array<bool, block_size> active;
+    };
+
+    //! @brief The finaliser of splitmix64.
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    //! @brief The block with a given index, allocated by the first step reaching it.
+    block& get_block(size_t k) {
+        block* b = m_blocks[k].load(std::memory_order_acquire);
+        if (b != nullptr) return *b;
+        std::unique_ptr<block> nb(new block(m_seed, k * block_size));
+        if (m_blocks[k].compare_exchange_strong(b, nb.get(), std::memory_order_acq_rel)) return *nb.release();
+        return *b;
+    }
+
+    //! @brief The seed of the random generators of devices.
+    uint64_t const m_seed;
+    //! @brief The blocks of devices (null until allocated).
+    std::vector<std::atomic<block*>> m_blocks;
+};
+
+template <size_t n>
+constexpr size_t engine<n>::block_size;
+
+
+/**
+ * @brief Distribution initialising every device of a network with the same engine.
+ *
+ * The engine is created together with the distribution (once per network), with a seed
+ * drawn from the random generator of the network.
+ */
+template <size_t n>
+class shared_engine {
+  public:
+    //! @brief The type of results of the distribution.
+    using type = std::shared_ptr<engine<n>>;
+
+    //! @brief Constructor with a random generator.
+    template <typename G>
+    shared_engine(G&& g) : m_engine(std::make_shared<engine<n>>((uint64_t(g()) << 32) ^ uint64_t(g()))) {}
+
+    //! @brief Constructor with a random generator and a tuple of initialisation values.
+    template <typename G, typename S, typename T>
+    shared_engine(G&& g, common::tagged_tuple<S,T> const&) : shared_engine(g) {}
+
+    //! @brief The engine of the network.
+    template <typename G>
+    type operator()(G&&) {
+        return m_engine;
+    }
+
+    //! @brief The engine of the network.
+    template <typename G, typename S, typename T>
+    type operator()(G&&, common::tagged_tuple<S,T> const&) {
+        return m_engine;
+    }
+
+  private:
+    //! @brief The engine of the network.
+    type m_engine;
+};
+
+
+}
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+
+
+//! @brief Tags used in the node storage.
+namespace tags {
+    //! @brief The mobility engine of the network of a device (needed by `batch_walk`).
+    struct walk_engine {};
+}
+
+
+/**
+ * @brief Walks randomly in a rectangle at a maximum speed, returning the current target.
+ *
+ * Behaves as `rectangle_walk`, but targets and velocities are computed by the mobility engine
+ * in `node.storage(tags::walk_engine{})`, for all devices at once every `period` (which should
+ * be the same for all devices of a network).
+ */
+template <typename node_t, size_t n>
+vec<n> batch_walk(ARGS, vec<n> const& low, vec<n> const& hi, real_t max_v, real_t period) { CODE
+    vec<n> v = node.velocity();
+    vec<n> target = node.storage(tags::walk_engine{})->step(node.uid, node.current_time(), node.position(), v, low, hi, max_v, period);
+    node.velocity() = v;
+    return target;
+}
+//! @brief Exports for the batch_walk function (none).
+template <size_t n>
+FUN_EXPORT batch_walk_t = common::export_list<>;
+
+
+}
+
+
+}
+
+#endif // FCPP_MOBILITY_H_
@@ -0,0 +1,117 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file multi_gradient.hpp
+ * @brief Distances from multiple sources computed in a single neighbour exchange.
+ *
+ * Computing `k` gradients separately costs `k` exchanges with neighbours, and `k` passes
+ * over their values (plus more for broadcasting values along them). The `bis_gradients`
+ * function computes `k` BIS (Bounded Information Speed) distance estimates at once: the
+ * estimates of every source are packed into contiguous arrays shared through a single `nbr`,
+ * and updated through a single map and fold over the neighbours. Along every gradient, a
+ * value chosen by its source is also broadcast, so that no further exchange is needed.
+ */
+
+#ifndef FCPP_MULTI_GRADIENT_H_
+#define FCPP_MULTI_GRADIENT_H_
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include "lib/coordination.hpp"
+#include "lib/data.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Estimates of the distances from `k` sources, with values broadcast by them.
+template <size_t k>
+struct gradients {
+    //! @brief The distance estimates.
+    std::array<real_t, k> dist;
+    //! @brief The time elapsed since the information on each distance left its source.
+    std::array<times_t, k> lag;
+    //! @brief The values broadcast from each source.
+    std::array<real_t, k> value;
+
+    //! @brief Serialises the content from/to a given input/output stream.
+    template <typename S>
+    S& serialize(S& s) {
+        s & dist;
+        s & lag;
+        s & value;
+        return s;
+    }
+
+    //! @brief Serialises the content from/to a given output stream (const overload).
+    template <typename S>
+    S& serialize(S& s) const {
+        s << dist;
+        s << lag;
+        s << value;
+        return s;
+    }
+};
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+
+
+/**
+ * @brief Computes the BIS distances from `k` sources in a single neighbour exchange.
+ *
+ * Every estimate is updated as in `bis_distance(CALL, sources[i], period, speed)`: through the
+ * neighbour minimising the sum of its estimate and distance, bounded below by the distance that
+ * information travels at `speed` in the lag accumulated since leaving the source (minus a period).
+ * Every source also broadcasts along its gradient the corresponding element of `values(dist)`, where
+ * `dist` are its distance estimates in the current round, which other devices receive from the
+ * neighbour they compute their estimate from (as `broadcast` would do).
+ */
+template <typename node_t, size_t k, typename F>
+gradients<k> bis_gradients(ARGS, std::array<bool, k> const& sources, F&& values, times_t period, real_t speed) { CODE
+    constexpr real_t inf = std::numeric_limits<real_t>::infinity();
+    gradients<k> loc;
+    for (size_t i = 0; i < k; ++i) {
+        loc.dist[i] = sources[i] ? 0 : inf;
+        loc.lag[i] = 0;
+        loc.value[i] = inf;
+    }
+    return nbr(CALL, loc, [&](field<gradients<k>> const& x){
+        // estimates through every neighbour, bounded below by the distance information could travel
+        field<gradients<k>> c = map_hood([&](gradients<k> g, real_t d, times_t l){
+            for (size_t i = 0; i < k; ++i) {
+                g.lag[i] += l;
+                g.dist[i] = std::max(g.dist[i] + d, (g.lag[i] - period) * speed);
+            }
+            return g;
+        }, x, node.nbr_dist(), node.nbr_lag());
+        gradients<k> r = fold_hood(CALL, [](gradients<k> const& g, gradients<k> r){
+            for (size_t i = 0; i < k; ++i) if (g.dist[i] < r.dist[i]) {
+                r.dist[i] = g.dist[i];
+                r.lag[i] = g.lag[i];
+                r.value[i] = g.value[i];
+            }
+            return r;
+        }, c, loc);
+        std::array<real_t, k> v = values(r.dist);
+        for (size_t i = 0; i < k; ++i) if (sources[i]) r.value[i] = v[i];
+        return r;
+    });
+}
+//! @brief Exports for the bis_gradients function.
+template <size_t k>
+FUN_EXPORT bis_gradients_t = common::export_list<gradients<k>>;
+
+
+}
+
+
+}
+
+#endif // FCPP_MULTI_GRADIENT_H_
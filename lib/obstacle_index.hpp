@@ -0,0 +1,187 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file obstacle_index.hpp
+ * @brief Precomputed nearest-feature index of the obstacles of a simulated map.
+ */
+
+#ifndef FCPP_OBSTACLE_INDEX_H_
+#define FCPP_OBSTACLE_INDEX_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "lib/data.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+/**
+ * @brief Grid index answering obstacle queries on a planar area in constant time.
+ *
+ * The area is sampled once on a grid through the `is_obstacle` method of a network
+ * object. Then an exact Euclidean distance transform (Felzenszwalb-Huttenlocher, tracking
+ * the minimising cell) associates to every cell the closest obstacle cell and the closest
+ * free cell, so that every query is an array read. Coordinates beyond the first two are
+ * copied from the query point.
+ *
+ * Obstacles are approximated by the cells whose centre is an obstacle. The returned feature
+ * is the point of the closest feature cell which is closest to the query point, so that it is
+ * on the boundary of the approximated obstacle (or free space), but cells are compared by their
+ * centres: the distance to the returned point may exceed the true one by up to `res`.
+ */
+class obstacle_index {
+  public:
+    //! @brief Empty constructor (no obstacles).
+    obstacle_index() = default;
+
+    //! @brief Samples the obstacles of a network in the rectangle `[x0,x1] x [y0,y1]` with a given resolution.
+    template <typename net_t>
+    obstacle_index(net_t& net, real_t x0, real_t y0, real_t x1, real_t y1, real_t res) :
+        m_x0(x0), m_y0(y0), m_res(res),
+        m_w(std::max<size_t>(std::ceil((x1-x0)/res), 1)),
+        m_h(std::max<size_t>(std::ceil((y1-y0)/res), 1)),
+        m_obstacle(m_w*m_h) {
+        for (size_t j = 0; j < m_h; ++j)
+            for (size_t i = 0; i < m_w; ++i)
+                m_obstacle[j*m_w+i] = net.is_obstacle(make_vec(center(i, m_x0), center(j, m_y0), 0));
+        transform(true,  m_closest_obstacle);
+        transform(false, m_closest_space);
+    }
+
+    //! @brief Whether a point is inside an obstacle.
+    template <size_t n>
+    bool is_obstacle(vec<n> const& p) const {
+        return m_obstacle.size() and m_obstacle[cell(p)];
+    }
+
+    //! @brief The closest obstacle point (at infinite distance if there are no obstacles).
+    template <size_t n>
+    vec<n> closest_obstacle(vec<n> const& p) const {
+        return feature(p, m_closest_obstacle);
+    }
+
+    //! @brief The closest point which is not an obstacle (at infinite distance if there is none).
+    template <size_t n>
+    vec<n> closest_space(vec<n> const& p) const {
+        return feature(p, m_closest_space);
+    }
+
+  private:
+    //! @brief Marker for cells with no feature.
+    static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+    //! @brief Center coordinate of the i-th cell along an axis starting at `o`.
+    real_t center(size_t i, real_t o) const {
+        return o + (i + real_t(0.5)) * m_res;
+    }
+
+    //! @brief The cell containing a point (clamped to the grid).
+    template <size_t n>
+    size_t cell(vec<n> const& p) const {
+        long long i = std::floor((p[0] - m_x0) / m_res);
+        long long j = std::floor((p[1] - m_y0) / m_res);
+        i = std::min<long long>(std::max<long long>(i, 0), m_w-1);
+        j = std::min<long long>(std::max<long long>(j, 0), m_h-1);
+        return j*m_w+i;
+    }
+
+    //! @brief The point of the feature cell associated to the cell of a point.
+    template <size_t n>
+    vec<n> feature(vec<n> const& p, std::vector<uint32_t> const& f) const {
+        vec<n> q = p;
+        uint32_t c = f.size() ? f[cell(p)] : none;
+        if (c == none) {
+            q[0] = q[1] = std::numeric_limits<real_t>::infinity();
+            return q;
+        }
+        // the point of the feature cell closest to the query point
+        real_t cx = center(c % m_w, m_x0), cy = center(c / m_w, m_y0), h = m_res / 2;
+        q[0] = std::min(std::max(p[0], cx - h), cx + h);
+        q[1] = std::min(std::max(p[1], cy - h), cy + h);
+        return q;
+    }
+
+    //! @brief Computes the closest cell with `m_obstacle` equal to `v`, for every cell.
+    void transform(bool v, std::vector<uint32_t>& out) const {
+        constexpr double inf = std::numeric_limits<double>::infinity();
+        // vertical pass: closest feature row in the same column
+        std::vector<uint32_t> row(m_w*m_h, uint32_t(none));
+        for (size_t i = 0; i < m_w; ++i) {
+            uint32_t last = none;
+            for (size_t j = 0; j < m_h; ++j) {
+                if (m_obstacle[j*m_w+i] == v) last = j;
+                row[j*m_w+i] = last;
+            }
+            last = none;
+            for (size_t j = m_h; j-- > 0;) {
+                if (m_obstacle[j*m_w+i] == v) last = j;
+                uint32_t& r = row[j*m_w+i];
+                if (last != none and (r == none or last - j < j - r)) r = last;
+            }
+        }
+        // horizontal pass: lower envelope of the parabolas centered in every column
+        out.assign(m_w*m_h, uint32_t(none));
+        std::vector<size_t> cols(m_w);
+        std::vector<double> f(m_w), z(m_w+1);
+        for (size_t j = 0; j < m_h; ++j) {
+            for (size_t i = 0; i < m_w; ++i) {
+                uint32_t r = row[j*m_w+i];
+                f[i] = r == none ? inf : (double(r) - j) * (double(r) - j);
+            }
+            auto inter = [&](size_t q, size_t p) {
+                return ((f[q] + double(q)*q) - (f[p] + double(p)*p)) / (2.0*q - 2.0*p);
+            };
+            long long k = -1;
+            for (size_t q = 0; q < m_w; ++q) {
+                if (f[q] == inf) continue;
+                if (k < 0) {
+                    k = 0;
+                    cols[0] = q;
+                    z[0] = -inf;
+                    z[1] = +inf;
+                    continue;
+                }
+                double s = inter(q, cols[k]);
+                while (s <= z[k]) {
+                    --k;
+                    s = inter(q, cols[k]);
+                }
+                ++k;
+                cols[k] = q;
+                z[k] = s;
+                z[k+1] = +inf;
+            }
+            if (k < 0) continue;
+            for (size_t i = 0, l = 0; i < m_w; ++i) {
+                while (z[l+1] < i) ++l;
+                out[j*m_w+i] = row[j*m_w+cols[l]] * m_w + cols[l];
+            }
+        }
+    }
+
+    //! @brief Origin of the grid.
+    real_t m_x0 = 0, m_y0 = 0;
+    //! @brief Side of a cell.
+    real_t m_res = 1;
+    //! @brief Number of columns and rows of the grid.
+    size_t m_w = 1, m_h = 1;
+    //! @brief Whether every cell is an obstacle.
+    std::vector<bool> m_obstacle;
+    //! @brief Closest obstacle cell for every cell.
+    std::vector<uint32_t> m_closest_obstacle;
+    //! @brief Closest free cell for every cell.
+    std::vector<uint32_t> m_closest_space;
+};
+
+
+}
+
+#endif // FCPP_OBSTACLE_INDEX_H_
@@ -0,0 +1,198 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file profile.hpp
+ * @brief Scoped timing of the functions called by aggregate programs.
+ *
+ * Profiling is enabled by compiling with `FCPP_PROFILE=1`, otherwise `PROFILE(S, e)` expands
+ * to `e` alone. When enabled, `PROFILE(S, e)` evaluates `e` measuring the elapsed cycles
+ * (time stamp counter on x86, nanoseconds elsewhere), which are:
+ * - stored into `node.storage(S{})`, so that they can be logged through aggregators
+ *   and plotted as any other value of a round;
+ * - counted into a per-thread histogram with logarithmic buckets, which can be printed
+ *   after the simulation through `profile::report`.
+ * Every tag should be profiled at most once per round, as the storage is overwritten.
+ */
+
+#ifndef FCPP_PROFILE_H_
+#define FCPP_PROFILE_H_
+
+#ifndef FCPP_PROFILE
+//! @brief Whether profiling is enabled.
+#define FCPP_PROFILE 0
+#endif
+
+#include <cstdint>
+
+#if FCPP_PROFILE
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#include "lib/common/tagged_tuple.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the profiling facility.
+namespace profile {
+
+
+//! @brief Number of buckets of histograms (bucket `i` counts durations in `[2^i, 2^(i+1))`).
+constexpr size_t buckets = 48;
+
+
+#if FCPP_PROFILE
+
+//! @brief Current value of the cycle counter.
+inline uint64_t cycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//! @brief Histogram of durations.
+using histogram = std::array<uint64_t, buckets>;
+
+//! @brief The registry of profiled tags and of the histograms of every thread.
+class registry {
+  public:
+    //! @brief Accesses the singleton.
+    static registry& get() {
+        static registry r;
+        return r;
+    }
+
+    //! @brief Registers a name, returning its index.
+    size_t key(std::string const& name) {
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_names.push_back(name);
+        return m_names.size() - 1;
+    }
+
+    //! @brief The histogram of the current thread for a given key.
+    histogram& local(size_t k) {
+        thread_local std::shared_ptr<std::vector<histogram>> t = attach();
+        if (t->size() <= k) t->resize(k+1, histogram{});
+        return (*t)[k];
+    }
+
+    //! @brief Prints the histograms merged across threads (to be called when no thread is profiling).
+    void report(std::ostream& o) {
+        std::lock_guard<std::mutex> l(m_mutex);
+        for (size_t k = 0; k < m_names.size(); ++k) {
+            histogram h{};
+            for (auto const& t : m_tables)
+                if (t->size() > k)
+                    for (size_t i = 0; i < buckets; ++i) h[i] += (*t)[k][i];
+            o << m_names[k] << ":";
+            for (size_t i = 0; i < buckets; ++i) if (h[i]) o << " " << (uint64_t(1) << i) << ":" << h[i];
+            o << "\n";
+        }
+    }
+
+  private:
+    //! @brief Creates and registers the table of histograms of a thread.
+    std::shared_ptr<std::vector<histogram>> attach() {
+        auto t = std::make_shared<std::vector<histogram>>();
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_tables.push_back(t);
+        return t;
+    }
+
+    //! @brief The registered names.
+    std::vector<std::string> m_names;
+    //! @brief The tables of histograms of every thread (kept after the thread exits).
+    std::vector<std::shared_ptr<std::vector<histogram>>> m_tables;
+    //! @brief Guards the names and tables.
+    std::mutex m_mutex;
+};
+
+//! @brief Index of a tag in the registry.
+template <typename S>
+size_t key() {
+    static size_t const k = registry::get().key(common::details::strip_namespaces(common::type_name<S>()));
+    return k;
+}
+
+//! @brief Logarithmic bucket of a duration.
+inline size_t bucket(uint64_t d) {
+    size_t i = 0;
+    while (d >>= 1) ++i;
+    return i < buckets ? i : buckets-1;
+}
+
+//! @brief Measures the cycles elapsed during its lifetime into the storage tag `S` of a node.
+template <typename S, typename node_t>
+class scope {
+  public:
+    //! @brief Starts the measurement.
+    scope(node_t& node) : m_node(node), m_start(cycles()) {}
+
+    //! @brief Ends the measurement.
+    ~scope() {
+        uint64_t d = cycles() - m_start;
+        m_node.storage(S{}) = d;
+        ++registry::get().local(key<S>())[bucket(d)];
+    }
+
+  private:
+    //! @brief The node being profiled.
+    node_t& m_node;
+    //! @brief The starting cycle count.
+    uint64_t m_start;
+};
+
+//! @brief Evaluates a function measuring its cycles into the storage tag `S` of a node.
+template <typename S, typename node_t, typename F>
+auto timed(node_t& node, F&& f) {
+    scope<S, node_t> s(node);
+    return f();
+}
+
+//! @brief Prints the histograms merged across threads.
+inline void report(std::ostream& o) {
+    registry::get().report(o);
+}
+
+#else
+
+//! @brief Prints the histograms merged across threads (disabled).
+template <typename O>
+void report(O&) {}
+
+#endif
+
+
+}
+
+
+}
+
+
+#if FCPP_PROFILE
+//! @brief Evaluates an expression in a round of `node`, measuring its cycles into the storage tag `S`.
+#define PROFILE(S, e)   ::fcpp::profile::timed<S>(node, [&]() { return e; })
+#else
+//! @brief Evaluates an expression in a round of `node` (profiling disabled).
+#define PROFILE(S, e)   (e)
+#endif
+
+#endif // FCPP_PROFILE_H_
@@ -0,0 +1,113 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file quiescence.hpp
+ * @brief Back-off of the rounds of devices whose inputs are not changing.
+ *
+ * Once a program has stabilised, a round recomputes the same values as the previous one.
+ * The `input_change` function measures how much a set of inputs changed since the previous
+ * round (a field changes if the value of a neighbour does, or if a neighbour joins or leaves
+ * with a value different from the default), and `quiescence` stretches the interval until the
+ * next planned round of a device whose inputs stayed within a tolerance for some rounds,
+ * doubling it up to a maximum factor, and restores the original schedule as soon as a change
+ * is detected. Since quiescent devices send messages less often, they should be retained by
+ * neighbours for at least the maximum interval between rounds.
+ */
+
+#ifndef FCPP_QUIESCENCE_H_
+#define FCPP_QUIESCENCE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "lib/coordination.hpp"
+#include "lib/data.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+
+
+//! @brief Namespace of implementation details.
+namespace details {
+    //! @brief Difference between two real values (zero if equal, also when infinite).
+    inline real_t gap(real_t x, real_t y) {
+        return x == y ? 0 : std::abs(x - y);
+    }
+
+    //! @brief Difference between two points.
+    template <size_t n>
+    real_t gap(vec<n> const& x, vec<n> const& y) {
+        return distance(x, y);
+    }
+
+    //! @brief Largest difference between the values of two fields, on the devices of either of them and elsewhere.
+    template <typename T>
+    real_t gap(field<T> const& x, field<T> const& y) {
+        real_t r = gap(fcpp::details::other(x), fcpp::details::other(y));
+        for (device_t i : fcpp::details::get_ids(x)) r = std::max(r, gap(fcpp::details::self(x, i), fcpp::details::self(y, i)));
+        for (device_t i : fcpp::details::get_ids(y)) r = std::max(r, gap(fcpp::details::self(x, i), fcpp::details::self(y, i)));
+        return r;
+    }
+
+    //! @brief Largest difference between corresponding elements of two tuples.
+    template <typename... Ts, size_t... is>
+    real_t max_gap(tuple<Ts...> const& x, tuple<Ts...> const& y, std::index_sequence<is...>) {
+        real_t r = 0;
+        int unused[] = {0, (r = std::max(r, gap(get<is>(x), get<is>(y))), 0)...};
+        (void)unused;
+        return r;
+    }
+}
+
+
+//! @brief Largest change of a set of inputs (reals, points or fields of reals) since the previous round (infinite in the first round).
+template <typename node_t, typename... Ts>
+real_t input_change(ARGS, Ts const&... xs) { CODE
+    tuple<Ts...> now(xs...);
+    real_t r = std::numeric_limits<real_t>::infinity();
+    old(CALL, make_tuple(false, now), [&](tuple<bool, tuple<Ts...>> const& prev){
+        if (get<0>(prev)) r = details::max_gap(get<1>(prev), now, std::index_sequence_for<Ts...>{});
+        return make_tuple(true, now);
+    });
+    return r;
+}
+//! @brief Exports for the input_change function.
+template <typename... Ts>
+FUN_EXPORT input_change_t = common::export_list<tuple<bool, tuple<Ts...>>>;
+
+
+/**
+ * @brief Backs off the rounds of a device whose inputs are stable, returning the back-off factor.
+ *
+ * After `patience` consecutive rounds with a `change` of at most `tol`, the interval until the
+ * next planned round is doubled with every further stable round, up to `max_backoff` times.
+ */
+FUN int quiescence(ARGS, real_t change, real_t tol, int max_backoff, int patience = 3) { CODE
+    int stable = old(CALL, 0, [&](int s){
+        return change <= tol ? s + 1 : 0;
+    });
+    int f = 1;
+    for (int i = patience; i < stable and f < max_backoff; ++i) f *= 2;
+    f = std::min(f, max_backoff);
+    if (f > 1) node.next_time(node.current_time() + f * (node.next_time() - node.current_time()));
+    return f;
+}
+//! @brief Exports for the quiescence function.
+FUN_EXPORT quiescence_t = common::export_list<int>;
+
+
+}
+
+
+}
+
+#endif // FCPP_QUIESCENCE_H_
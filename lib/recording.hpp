@@ -0,0 +1,473 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file recording.hpp
+ * @brief Recording of the graphical state of simulations, for later replay at any speed.
+ *
+ * A simulation wrapping its program into `recording::program` (typically run by the batch
+ * simulator, at full speed) writes the position, size, shape and colors of every node into
+ * a binary trace through the active `recording::writer`. A `recording::reader` reconstructs
+ * the state of the nodes at any time of the trace, seeking backwards and forwards.
+ *
+ * The trace is a sequence of frames at regular times. Every frame lists only the nodes whose
+ * state changed since the previous frame, each with a mask of the changed fields followed by
+ * their values. Every few frames, a key frame lists the full state of every node, so that
+ * seeking only needs to replay the frames after the closest key frame.
+ *
+ * File format: the `magic` header, the number of colors as `uint32_t`, and a sequence of frames.
+ * A frame is a `uint8_t` (1 for key frames), the time as `double`, the number of nodes as `uint32_t`,
+ * and for every node its identifier as `uint32_t`, its mask as `uint8_t` and the changed fields
+ * (position as three `float`, size as `float`, shape as `uint8_t`, colors as RGBA `uint32_t`).
+ */
+
+#ifndef FCPP_RECORDING_H_
+#define FCPP_RECORDING_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "lib/data.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the recording and replay of simulations.
+namespace recording {
+
+
+//! @brief Magic number at the start of a recording file.
+constexpr char magic[8] = {'F','C','P','P','R','E','C','1'};
+
+//! @brief Maximum number of colors of a node.
+constexpr size_t max_colors = 5;
+
+//! @brief Mask bits of the fields of a node.
+enum field_bit : uint8_t {
+    position_bit = 1,
+    size_bit = 2,
+    shape_bit = 4,
+    color_bit = 8   // followed by the bits of the other colors
+};
+
+
+//! @brief The graphical state of a node.
+struct node_state {
+    //! @brief Whether the node is present.
+    bool present = false;
+    //! @brief The position (the first three coordinates).
+    std::array<float, 3> position{};
+    //! @brief The size.
+    float size = 0;
+    //! @brief The shape.
+    uint8_t shape = 0;
+    //! @brief The colors, as RGBA.
+    std::array<uint32_t, max_colors> colors{};
+
+    //! @brief The mask of the fields differing from another state.
+    uint8_t diff(node_state const& o, size_t k) const {
+        uint8_t m = 0;
+        if (not o.present or position != o.position) m |= position_bit;
+        if (not o.present or size != o.size) m |= size_bit;
+        if (not o.present or shape != o.shape) m |= shape_bit;
+        for (size_t i = 0; i < k; ++i)
+            if (not o.present or colors[i] != o.colors[i]) m |= color_bit << i;
+        return m;
+    }
+};
+
+
+//! @brief Packs a color as RGBA.
+inline uint32_t pack(color const& c) {
+    auto b = [](real_t x) {
+        return uint32_t(std::min<real_t>(std::max<real_t>(x, 0), 1) * 255 + real_t(0.5));
+    };
+    return (b(c.rgba[0]) << 24) | (b(c.rgba[1]) << 16) | (b(c.rgba[2]) << 8) | b(c.rgba[3]);
+}
+
+//! @brief Unpacks a color from RGBA.
+inline color unpack(uint32_t c) {
+    return color((c >> 24) / real_t(255), ((c >> 16) & 255) / real_t(255), ((c >> 8) & 255) / real_t(255), (c & 255) / real_t(255));
+}
+
+
+//! @brief Sets the position of a node state from a vector (keeping its first three coordinates).
+template <size_t n>
+void set_position(node_state& s, vec<n> const& p) {
+    for (size_t i = 0; i < std::min<size_t>(n, 3); ++i) s.position[i] = p[i];
+}
+
+
+/**
+ * @brief Writes the states of nodes into a recording file, as frames at regular times.
+ *
+ * Records are buffered by the thread making them, and merged into the states of the nodes
+ * by the first record reaching the time of the next frame, which writes the frame.
+ */
+class writer {
+  public:
+    /**
+     * @brief Opens a recording file, making the writer active.
+     *
+     * @param path The path of the file.
+     * @param colors The number of colors of every node.
+     * @param step The time between frames.
+     * @param key The number of frames between key frames.
+     */
+    writer(std::string const& path, size_t colors, times_t step = 0.1, size_t key = 50) :
+        m_file(std::fopen(path.c_str(), "wb")), m_colors(std::min(colors, max_colors)), m_step(step), m_key(key), m_id(++count()) {
+        if (m_file) {
+            uint32_t k = m_colors;
+            std::fwrite(magic, sizeof(magic), 1, m_file);
+            std::fwrite(&k, sizeof(uint32_t), 1, m_file);
+        }
+        active() = this;
+    }
+
+    //! @brief Writes the last frame and closes the file.
+    ~writer() {
+        if (active() == this) active() = nullptr;
+        if (not m_file) return;
+        flush(-INF);
+        frame(m_next);
+        std::fclose(m_file);
+    }
+
+    //! @brief The active writer (if any).
+    static writer*& active() {
+        static writer* w = nullptr;
+        return w;
+    }
+
+    //! @brief Records the state of a node at a given time.
+    void record(times_t t, device_t uid, node_state const& s) {
+        buffer& b = local();
+        {
+            std::lock_guard<std::mutex> l(b.mutex);
+            b.records.emplace_back(t, uid, s);
+        }
+        if (t >= m_next.load(std::memory_order_relaxed)) flush(t);
+    }
+
+  private:
+    //! @brief A record of the state of a node at a given time.
+    using record_type = std::tuple<times_t, device_t, node_state>;
+
+    //! @brief The records of a thread not yet merged (guarded by a mutex locked by other threads only when merging).
+    struct buffer {
+        //! @brief Guards the records.
+        std::mutex mutex;
+        //! @brief The records.
+        std::vector<record_type> records;
+    };
+
+    //! @brief The number of writers created.
+    static std::atomic<size_t>& count() {
+        static std::atomic<size_t> c{0};
+        return c;
+    }
+
+    //! @brief The buffer of the current thread.
+    buffer& local() {
+        thread_local std::pair<size_t, std::shared_ptr<buffer>> b{0, nullptr};
+        if (b.first != m_id) {
+            b = {m_id, std::make_shared<buffer>()};
+            std::lock_guard<std::mutex> l(m_mutex);
+            m_buffers.push_back(b.second);
+        }
+        return *b.second;
+    }
+
+    //! @brief Merges the records of every thread in time order, writing the frames until a given time.
+    void flush(times_t t) {
+        std::lock_guard<std::mutex> l(m_mutex);
+        std::vector<record_type> v;
+        for (auto const& b : m_buffers) {
+            std::lock_guard<std::mutex> lb(b->mutex);
+            v.insert(v.end(), b->records.begin(), b->records.end());
+            b->records.clear();
+        }
+        std::stable_sort(v.begin(), v.end(), [](record_type const& x, record_type const& y){
+            return std::get<0>(x) < std::get<0>(y);
+        });
+        times_t next = m_next.load(std::memory_order_relaxed);
+        for (record_type const& r : v) {
+            while (std::get<0>(r) >= next) {
+                frame(next);
+                next += m_step;
+            }
+            device_t uid = std::get<1>(r);
+            if (uid >= m_state.size()) {
+                m_state.resize(uid+1);
+                m_sent.resize(uid+1);
+                m_dirty.resize(uid+1);
+            }
+            m_state[uid] = std::get<2>(r);
+            m_state[uid].present = true;
+            if (not m_dirty[uid]) {
+                m_dirty[uid] = true;
+                m_changed.push_back(uid);
+            }
+        }
+        while (t >= next) {
+            frame(next);
+            next += m_step;
+        }
+        m_next.store(next, std::memory_order_relaxed);
+    }
+
+    //! @brief Writes a frame with the changes until a given time.
+    void frame(times_t t) {
+        if (not m_file) return;
+        uint8_t key = m_frames++ % m_key == 0;
+        std::vector<device_t> ids;
+        if (key) {
+            for (device_t i = 0; i < m_state.size(); ++i) if (m_state[i].present) ids.push_back(i);
+        } else {
+            std::sort(m_changed.begin(), m_changed.end());
+            ids = m_changed;
+        }
+        std::vector<uint8_t> masks;
+        for (device_t i : ids) masks.push_back(key ? m_state[i].diff(node_state{}, m_colors) : m_state[i].diff(m_sent[i], m_colors));
+        uint32_t n = 0;
+        for (uint8_t m : masks) n += m > 0;
+        std::fwrite(&key, 1, 1, m_file);
+        std::fwrite(&t, sizeof(double), 1, m_file);
+        std::fwrite(&n, sizeof(uint32_t), 1, m_file);
+        for (size_t j = 0; j < ids.size(); ++j) if (masks[j]) {
+            node_state const& s = m_state[ids[j]];
+            uint32_t uid = ids[j];
+            std::fwrite(&uid, sizeof(uint32_t), 1, m_file);
+            std::fwrite(&masks[j], 1, 1, m_file);
+            if (masks[j] & position_bit) std::fwrite(s.position.data(), sizeof(float), 3, m_file);
+            if (masks[j] & size_bit) std::fwrite(&s.size, sizeof(float), 1, m_file);
+            if (masks[j] & shape_bit) std::fwrite(&s.shape, 1, 1, m_file);
+            for (size_t i = 0; i < m_colors; ++i)
+                if (masks[j] & (color_bit << i)) std::fwrite(&s.colors[i], sizeof(uint32_t), 1, m_file);
+            m_sent[ids[j]] = s;
+        }
+        for (device_t i : m_changed) m_dirty[i] = false;
+        m_changed.clear();
+    }
+
+    //! @brief The recording file.
+    FILE* m_file;
+    //! @brief The number of colors of every node.
+    size_t m_colors;
+    //! @brief The time between frames.
+    times_t m_step;
+    //! @brief The number of frames between key frames.
+    size_t m_key;
+    //! @brief The number of frames written.
+    size_t m_frames = 0;
+    //! @brief The identifier of the writer (distinguishing the buffers of threads across writers).
+    size_t m_id;
+    //! @brief The time of the next frame.
+    std::atomic<times_t> m_next{0};
+    //! @brief The current state of every node.
+    std::vector<node_state> m_state;
+    //! @brief The state of every node as last written.
+    std::vector<node_state> m_sent;
+    //! @brief Whether every node changed since the last frame.
+    std::vector<bool> m_dirty;
+    //! @brief The nodes changed since the last frame.
+    std::vector<device_t> m_changed;
+    //! @brief The buffers of every thread recording.
+    std::vector<std::shared_ptr<buffer>> m_buffers;
+    //! @brief Serialises the merging of records and the registration of buffers.
+    std::mutex m_mutex;
+};
+
+
+//! @brief Reads a recording file, reconstructing the states of nodes at any time.
+class reader {
+  public:
+    //! @brief Reads a recording file (dropping a last frame which is truncated or not in time order).
+    reader(std::string const& path) {
+        FILE* f = std::fopen(path.c_str(), "rb");
+        if (not f) return;
+        std::fseek(f, 0, SEEK_END);
+        long size = std::ftell(f);
+        if (size > 0) {
+            m_data.resize(size);
+            std::fseek(f, 0, SEEK_SET);
+            m_data.resize(std::fread(m_data.data(), 1, m_data.size(), f));
+        }
+        std::fclose(f);
+        if (m_data.size() < sizeof(magic) + sizeof(uint32_t) or std::memcmp(m_data.data(), magic, sizeof(magic)) != 0) {
+            m_data.clear();
+            return;
+        }
+        size_t i = sizeof(magic);
+        m_colors = get<uint32_t>(i);
+        if (m_colors > max_colors) {
+            m_data.clear();
+            return;
+        }
+        // index the frames, checking that all their entries are within the file
+        while (i + 1 + sizeof(double) + sizeof(uint32_t) <= m_data.size()) {
+            size_t offset = i;
+            uint8_t key = get<uint8_t>(i);
+            double t = get<double>(i);
+            uint32_t n = get<uint32_t>(i);
+            size_t devices = m_devices;
+            bool whole = not std::isnan(t) and (m_times.empty() or t >= m_times.back());
+            for (uint32_t j = 0; whole and j < n; ++j) {
+                whole = i + sizeof(uint32_t) + 1 <= m_data.size();
+                if (not whole) break;
+                devices = std::max<size_t>(devices, get<uint32_t>(i) + 1);
+                uint8_t m = get<uint8_t>(i);
+                i += field_bytes(m);
+                whole = i <= m_data.size();
+            }
+            if (not whole) break;
+            m_offsets.push_back(offset);
+            m_keys.push_back(key);
+            m_times.push_back(t);
+            m_devices = devices;
+        }
+        m_state.resize(m_devices);
+    }
+
+    //! @brief Whether the file could be read.
+    bool good() const {
+        return m_times.size() > 0;
+    }
+
+    //! @brief The number of colors of every node.
+    size_t colors() const {
+        return m_colors;
+    }
+
+    //! @brief The number of nodes (the maximum identifier plus one).
+    size_t devices() const {
+        return m_devices;
+    }
+
+    //! @brief The time of the first frame.
+    times_t start() const {
+        return m_times.empty() ? 0 : m_times.front();
+    }
+
+    //! @brief The time of the last frame.
+    times_t end() const {
+        return m_times.empty() ? 0 : m_times.back();
+    }
+
+    //! @brief The states of every node at a given time (as of the last frame not after it, or the first frame if none).
+    std::vector<node_state> const& at(times_t t) {
+        if (m_times.empty()) return m_state;
+        size_t f = std::upper_bound(m_times.begin(), m_times.end(), t) - m_times.begin();
+        f = std::max<size_t>(f, 1) - 1;
+        size_t k = f;
+        while (k > 0 and not m_keys[k]) --k;
+        if (m_current < k or m_current > f) {
+            for (node_state& s : m_state) s.present = false;
+            m_current = k;
+            apply(k);
+        }
+        while (m_current < f) apply(++m_current);
+        return m_state;
+    }
+
+  private:
+    //! @brief Reads a value at an offset, advancing it.
+    template <typename T>
+    T get(size_t& i) const {
+        T x;
+        std::memcpy(&x, m_data.data() + i, sizeof(T));
+        i += sizeof(T);
+        return x;
+    }
+
+    //! @brief The number of bytes of the fields in a mask.
+    size_t field_bytes(uint8_t m) const {
+        size_t b = 0;
+        if (m & position_bit) b += 3 * sizeof(float);
+        if (m & size_bit) b += sizeof(float);
+        if (m & shape_bit) b += 1;
+        for (size_t i = 0; i < m_colors; ++i) if (m & (color_bit << i)) b += sizeof(uint32_t);
+        return b;
+    }
+
+    //! @brief Applies the changes in a frame to the current states (only frames checked when indexing).
+    void apply(size_t f) {
+        size_t i = m_offsets[f] + 1 + sizeof(double);
+        uint32_t n = get<uint32_t>(i);
+        for (uint32_t j = 0; j < n; ++j) {
+            node_state& s = m_state[get<uint32_t>(i)];
+            uint8_t m = get<uint8_t>(i);
+            s.present = true;
+            if (m & position_bit) for (float& x : s.position) x = get<float>(i);
+            if (m & size_bit) s.size = get<float>(i);
+            if (m & shape_bit) s.shape = get<uint8_t>(i);
+            for (size_t c = 0; c < m_colors; ++c) if (m & (color_bit << c)) s.colors[c] = get<uint32_t>(i);
+        }
+    }
+
+    //! @brief The content of the file.
+    std::vector<char> m_data;
+    //! @brief The number of colors of every node.
+    size_t m_colors = 0;
+    //! @brief The number of nodes.
+    size_t m_devices = 0;
+    //! @brief The offset of every frame.
+    std::vector<size_t> m_offsets;
+    //! @brief The time of every frame.
+    std::vector<times_t> m_times;
+    //! @brief Whether every frame is a key frame.
+    std::vector<bool> m_keys;
+    //! @brief The last frame applied to the current states.
+    size_t m_current = -1;
+    //! @brief The current states of every node.
+    std::vector<node_state> m_state;
+};
+
+
+/**
+ * @brief Program wrapper running `P` and recording the state of the node into the active writer.
+ *
+ * @tparam P The program to be run.
+ * @tparam Z The tag of the size of a node.
+ * @tparam S The tag of the shape of a node.
+ * @tparam Cs The tags of the colors of a node.
+ */
+template <typename P, typename Z, typename S, typename... Cs>
+struct program {
+    //! @brief Executes a round of the wrapped program.
+    template <typename node_t>
+    void operator()(node_t& node, times_t t) {
+        P{}(node, t);
+        writer* w = writer::active();
+        if (w == nullptr) return;
+        node_state s;
+        set_position(s, node.position());
+        s.size = node.storage(Z{});
+        s.shape = uint8_t(node.storage(S{}));
+        uint32_t c[] = {pack(node.storage(Cs{}))...};
+        std::copy(c, c + std::min(sizeof...(Cs), max_colors), s.colors.begin());
+        w->record(node.current_time(), node.uid, s);
+    }
+};
+
+
+}
+
+
+}
+
+#endif // FCPP_RECORDING_H_
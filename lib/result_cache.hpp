@@ -0,0 +1,338 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file result_cache.hpp
+ * @brief Content-addressed cache of the rows logged by the simulations of a parameter sweep.
+ *
+ * Every simulation of a sweep is identified by a hash of its initialisation values, of the options
+ * of the simulated component (including program and exports) except for the plotter, and of the
+ * running program binary.
+ * The rows logged by a simulation are stored in a file named after that hash (`<dir>/<hash>.rows`),
+ * and `cache::run` only simulates the parameter points whose file is missing: the rows of every
+ * point, cached or just computed, are then replayed into the plotter in the order of the sweep,
+ * so that the result does not depend on the content of the cache. Any change to the code which
+ * changes the binary (including the body of the program and constants) discards the cache.
+ */
+
+#ifndef FCPP_RESULT_CACHE_H_
+#define FCPP_RESULT_CACHE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "lib/fcpp.hpp"
+#include "lib/sweep.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the result cache of parameter sweeps.
+namespace cache {
+
+
+//! @brief The initial value of hashes (FNV-1a offset basis).
+constexpr uint64_t hash_seed = 14695981039346656037ULL;
+
+//! @brief Extends a hash with a sequence of bytes (FNV-1a).
+inline uint64_t hash(uint64_t h, void const* data, size_t n) {
+    unsigned char const* p = static_cast<unsigned char const*>(data);
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 1099511628211ULL;
+    return h;
+}
+
+//! @brief Extends a hash with a string.
+inline uint64_t hash(uint64_t h, std::string const& s) {
+    return hash(h, s.data(), s.size() + 1);
+}
+
+
+//! @brief Namespace of implementation details.
+namespace details {
+    //! @brief Maps every type to void, for detecting member templates.
+    template <typename T>
+    struct to_void {
+        //! @brief The result.
+        using type = void;
+    };
+
+    //! @brief The option `T` as it affects the simulation (itself for options other than lists and plotters).
+    template <typename T, typename = void>
+    struct option_key {
+        //! @brief The result.
+        using type = T;
+    };
+
+    //! @brief The option `T` as it affects the simulation (options list specialisation).
+    template <typename T>
+    struct option_key<T, typename to_void<typename T::template apply_template<common::type_sequence>>::type> {
+        //! @brief The result, listing the options in the list.
+        using type = typename option_key<typename T::template apply_template<common::type_sequence>>::type;
+    };
+
+    //! @brief The option `T` as it affects the simulation (type sequence specialisation).
+    template <typename... Ts>
+    struct option_key<common::type_sequence<Ts...>, void> {
+        //! @brief The result.
+        using type = common::type_sequence<typename option_key<Ts>::type...>;
+    };
+
+    //! @brief The option `T` as it affects the simulation (plotters do not).
+    template <typename P>
+    struct option_key<component::tags::plot_type<P>, void> {
+        //! @brief The result.
+        using type = void;
+    };
+
+    //! @brief Extends a hash with an arithmetic value.
+    template <typename T>
+    uint64_t hash_value(uint64_t h, T const& x, std::true_type) {
+        double d = x;
+        return hash(h, &d, sizeof(double));
+    }
+
+    //! @brief Ignores other values (as output streams), which do not affect the simulation.
+    template <typename T>
+    uint64_t hash_value(uint64_t h, T const&, std::false_type) {
+        return h;
+    }
+
+    //! @brief Helper class hashing initialisation values of a given type.
+    template <typename T>
+    struct init_hash;
+
+    //! @brief Helper class hashing initialisation values of a given type (tagged tuple specialisation).
+    template <typename... Ss, typename... Ts>
+    struct init_hash<common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>>> {
+        //! @brief Extends a hash with the tags and values of a tuple.
+        static uint64_t get(uint64_t h, common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>> const& t) {
+            int unused[] = {0, (h = hash_value(hash(h, typeid(Ss).name()), common::get<Ss>(t), std::is_arithmetic<Ts>{}), 0)...};
+            (void)unused;
+            return h;
+        }
+    };
+
+    //! @brief Feeds the rows of a cache file into a plotter of type `P` (set once a row type is known).
+    template <typename P>
+    std::function<void(std::vector<double> const&, P&)>& replayer() {
+        static std::function<void(std::vector<double> const&, P&)> f;
+        return f;
+    }
+
+    //! @brief The identifier of the running process.
+    inline long process_id() {
+#ifdef _WIN32
+        return _getpid();
+#else
+        return getpid();
+#endif
+    }
+
+    /**
+     * @brief The hash of the running program binary.
+     *
+     * It is the `FCPP_BINARY_HASH` macro if defined (e.g., by the build system), otherwise the hash of
+     * the contents of `/proc/self/exe`. If neither is available, it differs in every process, so that
+     * results are never reused across builds (nor across runs).
+     */
+    inline uint64_t binary_hash() {
+#ifdef FCPP_BINARY_HASH
+        static uint64_t h = hash(hash_seed, std::string(FCPP_BINARY_HASH));
+#else
+        static uint64_t h = []{
+            std::ifstream f("/proc/self/exe", std::ios::binary);
+            std::vector<char> buf(1 << 16);
+            uint64_t r = hash_seed;
+            size_t n = 0;
+            while (f.read(buf.data(), buf.size()) or f.gcount() > 0) {
+                r = hash(r, buf.data(), size_t(f.gcount()));
+                n += size_t(f.gcount());
+            }
+            if (n > 0) return r;
+            auto now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+            return hash(hash(r, &now, sizeof(now)), std::to_string(process_id()));
+        }();
+#endif
+        return h;
+    }
+
+    /**
+     * @brief Sets the replayer of rows of type `R` into plotters of type `P`.
+     *
+     * It is initialised before `main` as soon as `writer<P>` is instantiated for rows of type `R`
+     * (i.e., when the logger of a simulation is compiled), so that cached rows can be replayed
+     * even if no simulation has been run.
+     */
+    template <typename P, typename R>
+    bool const registered = (replayer<P>() = [](std::vector<double> const& data, P& p){
+        using io = sweep::details::row_split<R>;
+        std::vector<double> k, v;
+        io::split(R{}, k, v);
+        size_t cols = v.size();
+        for (size_t i = 0; cols > 0 and i + cols <= data.size(); i += cols)
+            p << io::join(k, std::vector<double>(data.begin() + i, data.begin() + i + cols));
+    }, true);
+}
+
+
+/**
+ * @brief The hash identifying the simulations with options `O`.
+ *
+ * It combines the hash of the program binary with the types of the options (with nested options
+ * lists expanded), including program and exports but excluding `plot_type`, so that simulations with
+ * different options never share results within the same binary.
+ */
+template <typename O>
+uint64_t options_hash() {
+    static uint64_t h = hash(details::binary_hash(), typeid(typename details::option_key<O>::type).name());
+    return h;
+}
+
+
+//! @brief The file in directory `dir` of the simulation with options `O` and initialisation values `init`.
+template <typename O, typename T>
+std::string entry_path(std::string const& dir, T const& init) {
+    uint64_t h = details::init_hash<T>::get(options_hash<O>(), init);
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)h);
+    return dir + "/" + name + ".rows";
+}
+
+
+/**
+ * @brief Plotter collecting logged rows for a cache file, to be replayed into a plotter of type `P`.
+ *
+ * It can be used as `plot_type` of a simulation in place of `P`. Rows are kept in memory, and written
+ * into the cache file only by `commit` (after the simulation completed).
+ */
+template <typename P>
+class writer {
+  public:
+    //! @brief Writes a row.
+    template <typename R>
+    writer& operator<<(R const& row) {
+        (void)details::registered<P, R>;
+        std::vector<double> k;
+        sweep::details::row_split<R>::split(row, k, m_data);
+        return *this;
+    }
+
+    //! @brief Feeds the written rows into a plotter.
+    void replay(P& p) const {
+        if (details::replayer<P>()) details::replayer<P>()(m_data, p);
+    }
+
+    /**
+     * @brief Stores the written rows into the cache file at a given path (returns false on failure).
+     *
+     * Rows are written into a temporary file of the running process, which is renamed into the cache
+     * file once complete, so that a cache file is never read while it is being written.
+     */
+    bool commit(std::string const& path) const {
+        std::string tmp = path + "." + std::to_string(details::process_id()) + ".tmp";
+        std::ofstream f(tmp, std::ios::binary);
+        f.write(reinterpret_cast<char const*>(m_data.data()), m_data.size() * sizeof(double));
+        f.close();
+        // another process may have stored the same entry meanwhile
+        bool ok = not f.fail() and (std::rename(tmp.c_str(), path.c_str()) == 0 or std::ifstream(path));
+        if (not ok) std::remove(tmp.c_str());
+        return ok;
+    }
+
+  private:
+    //! @brief The values of the written rows.
+    std::vector<double> m_data;
+};
+
+
+//! @brief Feeds the rows of a cache file into a plotter (returns false if the file cannot be read).
+template <typename P>
+bool replay(std::string const& path, P& p) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (not f) return false;
+    std::vector<double> data(size_t(f.tellg()) / sizeof(double));
+    f.seekg(0);
+    if (not f.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(double))) return false;
+    if (details::replayer<P>()) details::replayer<P>()(data, p);
+    return true;
+}
+
+
+/**
+ * @brief Runs a sequence of simulations in parallel, skipping those whose rows are cached.
+ *
+ * The rows of every simulation are then replayed into `p`, in the order of `v`. Points of `v` with
+ * the same cache file are simulated once. Simulations whose rows cannot be stored are reported on
+ * standard error, and their rows are still replayed.
+ *
+ * @tparam O The options of the batch simulator to be run, whose `plot_type` is `writer<P>`.
+ * @param v A sequence of initialisation values (as produced by `batch::make_tagged_tuple_sequence`), without plotter.
+ * @param p The plotter object receiving the rows of every simulation (in the order of `v`).
+ * @param dir The directory of the cache files (created if missing).
+ * @param threads The number of worker threads.
+ * @return The number of simulations which were not cached.
+ */
+template <typename O, typename S, typename P>
+size_t run(S const& v, P& p, std::string const& dir, size_t threads = sweep::default_threads()) {
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+    std::vector<std::string> paths;
+    // the first point of every missing cache file, and its index among them by path
+    std::vector<size_t> missing;
+    std::map<std::string, size_t> simulated;
+    for (size_t i = 0; i < v.size(); ++i) {
+        auto init = v[i];
+        paths.push_back(entry_path<O>(dir, init));
+        if (simulated.count(paths.back()) == 0 and not std::ifstream(paths.back())) {
+            simulated[paths.back()] = missing.size();
+            missing.push_back(i);
+        }
+    }
+    std::vector<writer<P>> writers(missing.size());
+    std::atomic<size_t> failed{0};
+    sweep::parallel_for(missing.size(), threads, [&](size_t j, size_t){
+        size_t i = missing[j];
+        auto init = common::tagged_tuple_cat(v[i], common::make_tagged_tuple<component::tags::plotter>(&writers[j]));
+        typename component::batch_simulator<O>::net network{init};
+        network.run();
+        if (not writers[j].commit(paths[i])) ++failed;
+    });
+    if (failed > 0) std::cerr << "could not store " << failed << " of " << missing.size() << " results in " << dir << std::endl;
+    for (std::string const& path : paths) {
+        auto it = simulated.find(path);
+        if (it != simulated.end()) writers[it->second].replay(p);
+        else if (not replay(path, p)) std::cerr << "could not read " << path << std::endl;
+    }
+    return missing.size();
+}
+
+}
+
+
+}
+
+#endif // FCPP_RESULT_CACHE_H_
@@ -0,0 +1,271 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file snapshot.hpp
+ * @brief Ground truth about the devices of a network, published by every device and readable by rounds without locks.
+ *
+ * Rounds measuring the accuracy of a program often need oracle data, such as the true position
+ * of the source, which can only be read from the network object. Reading it from another node
+ * in every round is an access to state written by other threads. A `snapshot::board<T>` instead
+ * holds a slot with data of type `T` for every device, which only the device itself writes (in
+ * its own rounds) while other devices read it: the data is copied word by word, as in a sequence
+ * lock, so that readers never write to shared memory and writers never wait for readers.
+ *
+ * A board is shared by the devices of a network through the storage tag `tags::snapshot_board`,
+ * initialised by the `snapshot::shared_board<T>` distribution (which creates a single board per
+ * network, released with it).
+ */
+
+#ifndef FCPP_SNAPSHOT_H_
+#define FCPP_SNAPSHOT_H_
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "lib/common/tagged_tuple.hpp"
+#include "lib/data.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+
+
+//! @brief Tags used in the node storage.
+namespace tags {
+    //! @brief The snapshot board of the network of a device.
+    struct snapshot_board {};
+}
+
+
+}
+
+
+//! @brief Namespace containing the ground truth snapshot service.
+namespace snapshot {
+
+
+/**
+ * @brief Data of every device, published by the device itself and readable without locks.
+ *
+ * Devices are identified by their (dense) unique identifiers, and their slots are grouped into
+ * blocks of `block_size` consecutive identifiers, allocated on the first publication of one of
+ * their devices. The slot of a device must not be published from more than one thread at a time.
+ *
+ * @tparam T The (trivially copyable) type of the data.
+ */
+template <typename T>
+class board {
+    static_assert(std::is_trivially_copyable<T>::value, "snapshot data must be trivially copyable");
+
+  public:
+    //! @brief Number of consecutive devices sharing an allocation.
+    static constexpr size_t block_size = 256;
+
+    //! @brief Constructor with the maximum number of devices.
+    board(size_t capacity = size_t(1) << 22) : m_blocks((capacity + block_size - 1) / block_size) {
+        for (auto& b : m_blocks) b.store(nullptr, std::memory_order_relaxed);
+    }
+
+    //! @brief Deleted copy constructor.
+    board(board const&) = delete;
+
+    //! @brief Deleted copy assignment.
+    board& operator=(board const&) = delete;
+
+    //! @brief Destructor, releasing the blocks.
+    ~board() {
+        for (auto& b : m_blocks) delete b.load(std::memory_order_relaxed);
+    }
+
+    //! @brief Publishes the data of a device (from its own thread).
+    void publish(device_t d, T const& x) {
+        if (d / block_size >= m_blocks.size()) throw std::out_of_range("snapshot board: device identifier beyond capacity");
+        get_block(d / block_size)[d % block_size].store(x);
+    }
+
+    //! @brief Reads the data of a device into `x`, returning whether it was ever published.
+    bool read(device_t d, T& x) const {
+        if (d / block_size >= m_blocks.size()) return false;
+        block const* b = m_blocks[d / block_size].load(std::memory_order_acquire);
+        return b != nullptr and (*b)[d % block_size].load(x);
+    }
+
+    //! @brief Maximum number of devices.
+    size_t capacity() const {
+        return m_blocks.size() * block_size;
+    }
+
+  private:
+    //! @brief Number of words holding the data.
+    static constexpr size_t words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    //! @brief The data of a device.
+    struct slot {
+        //! @brief Twice the number of publications (odd while being published).
+        std::atomic<uint64_t> version{0};
+        //! @brief The words of the data.
+        std::array<std::atomic<uint64_t>, words> data;
+
+        //! @brief Copies the data out of the slot, returning whether it was ever published.
+        bool load(T& x) const {
+            uint64_t w[words];
+            while (true) {
+                uint64_t v = version.load(std::memory_order_acquire);
+                if (v == 0) return false;
+                if (v % 2 == 1) {
+                    // the data is being published
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (size_t i = 0; i < words; ++i) w[i] = data[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (version.load(std::memory_order_relaxed) == v) break;
+            }
+            std::memcpy(static_cast<void*>(&x), static_cast<void const*>(w), sizeof(T));
+            return true;
+        }
+
+        //! @brief Copies data into the slot (from a single thread at a time).
+        void store(T const& x) {
+            uint64_t w[words] = {};
+            std::memcpy(static_cast<void*>(w), static_cast<void const*>(&x), sizeof(T));
+            uint64_t v = version.load(std::memory_order_relaxed);
+            version.store(v + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < words; ++i) data[i].store(w[i], std::memory_order_relaxed);
+            version.store(v + 2, std::memory_order_release);
+        }
+    };
+
+    //! @brief The slots of a block of devices.
+    using block = std::array<slot, block_size>;
+
+    //! @brief The block with a given index, allocated by the first publication reaching it.
+    block& get_block(size_t k) {
+        block* b = m_blocks[k].load(std::memory_order_acquire);
+        if (b != nullptr) return *b;
+        std::unique_ptr<block> nb(new block());
+        if (m_blocks[k].compare_exchange_strong(b, nb.get(), std::memory_order_acq_rel)) return *nb.release();
+        return *b;
+    }
+
+    //! @brief The blocks of devices (null until allocated).
+    std::vector<std::atomic<block*>> m_blocks;
+};
+
+template <typename T>
+constexpr size_t board<T>::block_size;
+
+
+/**
+ * @brief Distribution initialising every device of a network with the same board.
+ *
+ * The board is created together with the distribution, once per network.
+ */
+template <typename T>
+class shared_board {
+  public:
+    //! @brief The type of results of the distribution.
+    using type = std::shared_ptr<board<T>>;
+
+    //! @brief Constructor with a random generator.
+    template <typename G>
+    shared_board(G&&) : m_board(std::make_shared<board<T>>()) {}
+
+    //! @brief Constructor with a random generator and a tuple of initialisation values.
+    template <typename G, typename S, typename U>
+    shared_board(G&& g, common::tagged_tuple<S,U> const&) : shared_board(g) {}
+
+    //! @brief The board of the network.
+    template <typename G>
+    type operator()(G&&) {
+        return m_board;
+    }
+
+    //! @brief The board of the network.
+    template <typename G, typename S, typename U>
+    type operator()(G&&, common::tagged_tuple<S,U> const&) {
+        return m_board;
+    }
+
+  private:
+    //! @brief The board of the network.
+    type m_board;
+};
+
+
+//! @brief The state of a device at a given time.
+template <size_t n>
+struct device_state {
+    //! @brief Whether the device exists.
+    bool present;
+    //! @brief The time of the state.
+    times_t time;
+    //! @brief The position.
+    vec<n> position;
+    //! @brief The velocity.
+    vec<n> velocity;
+
+    //! @brief The position at a later time (assuming constant velocity).
+    vec<n> position_at(times_t t) const {
+        return position + velocity * (t - time);
+    }
+};
+
+
+/**
+ * @brief The state of the device selected by `select(t)` at its last round, after publishing the state of the current device.
+ *
+ * Every device publishes its own position and velocity whenever it calls this function, so that
+ * the position of the selected device at a later time is exactly extrapolated by `position_at`, as
+ * long as devices change their velocity only in their rounds, before calling this function. The
+ * selected device is not present if it never published its state. The node storage needs the tag
+ * `tags::snapshot_board` of type `std::shared_ptr<board<device_state<n>>>`: if it is empty, the state
+ * is read from the node of the selected device in the network, which is safe only in sequential runs.
+ */
+template <size_t n, typename node_t, typename S>
+device_state<n> selected_state(node_t& node, S&& select) {
+    times_t t = node.current_time();
+    device_t id = select(t);
+    device_state<n> s;
+    std::shared_ptr<board<device_state<n>>> const& b = node.storage(coordination::tags::snapshot_board{});
+    if (b) {
+        s.present = true;
+        s.time = t;
+        s.position = node.position();
+        s.velocity = node.velocity();
+        b->publish(node.uid, s);
+        if (id != node.uid and not b->read(id, s)) s.present = false;
+        return s;
+    }
+    s.time = t;
+    s.present = node.net.node_count(id);
+    if (s.present) {
+        auto& d = node.net.node_at(id);
+        s.position = d.position(t);
+        s.velocity = d.velocity();
+    }
+    return s;
+}
+
+
+}
+
+
+}
+
+#endif // FCPP_SNAPSHOT_H_
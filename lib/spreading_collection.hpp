@@ -12,6 +12,11 @@
 
 #include "lib/fcpp.hpp"
 
+#include "lib/handover.hpp"
+#include "lib/mobility.hpp"
+#include "lib/quiescence.hpp"
+#include "lib/snapshot.hpp"
+
 
 /**
  * @brief Namespace containing all the objects in the FCPP library.
@@ -43,6 +48,14 @@ constexpr size_t side = discrete_sqrt(devices * 3000);
 constexpr size_t height = 100;
 //! @brief Color hue scale.
 constexpr float hue_scale = 360.0f/(side+height);
+//! @brief Largest change of inputs between rounds for which a device is considered quiescent.
+constexpr real_t quiescence_tolerance = 0.5;
+//! @brief Maximum stretching of the interval between rounds of quiescent devices.
+constexpr int max_backoff = 4;
+//! @brief Time between switches of the source.
+constexpr int source_period = 50;
+//! @brief Time before a planned source handover at which the gradient of the next source starts.
+constexpr times_t handover_lead = 25;
 
 
 //! @brief Namespace containing the libraries of coordination routines.
@@ -53,6 +66,8 @@ namespace coordination {
 namespace tags {
     //! @brief The device movement speed.
     struct speed {};
+    //! @brief Side of the square area walked by devices (set at initialisation, so that it can scale with the network).
+    struct area_side {};
     //! @brief True distance of the current node from the source.
     struct true_distance {};
     //! @brief Computed distance of the current node from the source.
@@ -79,10 +94,11 @@ FUN bool select_source(ARGS, int step) { CODE
     // the source ID increases by 1 every "step" seconds
     device_t source_id = ((int)node.current_time()) / step;
     bool is_source = node.uid == source_id;
-    // retrieves from the net object the current true position of the source
-    vec<3> source_pos = node.position();
-    if (node.net.node_count(source_id))
-        source_pos = node.net.node_at(source_id).position(node.current_time());
+    // retrieves the position of the source, extrapolated from its state at its last round (exactly, as it moves at constant velocity between rounds)
+    snapshot::device_state<3> source = snapshot::selected_state<3>(node, [step](times_t t){
+        return device_t(int(t) / step);
+    });
+    vec<3> source_pos = source.present ? source.position_at(node.current_time()) : node.position();
     // store relevant values in the node storage
     node.storage(tags::true_distance{})     = distance(node.position(), source_pos);
     node.storage(tags::node_size{})         = is_source ? 20 : 10;
@@ -93,14 +109,15 @@ FUN bool select_source(ARGS, int step) { CODE
 FUN_EXPORT select_source_t = common::export_list<>;
 
 
-//! @brief Main function.
-MAIN() {
+//! @brief Composition of spreading and collection functions, backing off rounds once stable if `quiescent`, warming up handovers if `warm`.
+FUN void spreading_collection(ARGS, bool quiescent, bool warm) { CODE
     // random walk into a given rectangle with given speed
-    rectangle_walk(CALL, make_vec(0,0,0), make_vec(side,side,height), node.storage(tags::speed{}), 1);
-    // selects a different source every 50 simulated seconds
-    bool is_source = select_source(CALL, 50);
+    real_t s = node.storage(tags::area_side{});
+    batch_walk(CALL, make_vec(0,0,0), make_vec(s,s,height), node.storage(tags::speed{}), 1);
+    // selects a different source every source_period simulated seconds
+    bool is_source = select_source(CALL, source_period);
     // calculate distances from the source
-    double dist = abf_distance(CALL, is_source);
+    double dist = warm ? handover_distance(CALL, source_period, handover_lead) : abf_distance(CALL, is_source);
     // collect the maximum finite distance (diameter) back towards the source
     double sdiam = mp_collection(CALL, dist, dist, 0.0, [](double x, double y){
         x = isfinite(x) ? x : 0;
@@ -119,9 +136,40 @@ MAIN() {
     node.storage(tags::distance_c{})        = color::hsva(dist *hue_scale, 1, 1);
     node.storage(tags::source_diameter_c{}) = color::hsva(sdiam*hue_scale, 1, 1);
     node.storage(tags::diameter_c{})        = color::hsva(diam *hue_scale, 1, 1);
+    // inputs are the position, the source flag, the distances of neighbours and the values they determine
+    if (quiescent) {
+        real_t change = input_change(CALL, node.position(), real_t(is_source), nbr(CALL, dist), dist, sdiam, diam);
+        quiescence(CALL, change, quiescence_tolerance, max_backoff);
+    }
+}
+//! @brief Export types used by the spreading_collection function.
+FUN_EXPORT spreading_collection_t = common::export_list<batch_walk_t<3>, select_source_t, abf_distance_t, mp_collection_t<double, double>, broadcast_t<double, double>, handover_distance_t, double, input_change_t<vec<3>, real_t, field<double>, double, double, double>, quiescence_t>;
+
+
+//! @brief Main function.
+MAIN() {
+    spreading_collection(CALL, false, false);
 }
 //! @brief Export types used by the main function.
-FUN_EXPORT main_t = common::export_list<rectangle_walk_t<3>, select_source_t, abf_distance_t, mp_collection_t<double, double>, broadcast_t<double, double>>;
+FUN_EXPORT main_t = common::export_list<spreading_collection_t>;
+
+//! @brief Main program backing off the rounds of stable devices (alternative to main).
+struct quiescent_main {
+    //! @brief Executes a round of the program.
+    template <typename node_t>
+    void operator()(node_t& node, times_t) {
+        spreading_collection(node, 0, true, false);
+    }
+};
+
+//! @brief Main program warming up the gradient of the next source before handovers (alternative to main).
+struct warm_main {
+    //! @brief Executes a round of the program.
+    template <typename node_t>
+    void operator()(node_t& node, times_t) {
+        spreading_collection(node, 0, false, true);
+    }
+};
 
 
 } // namespace coordination
@@ -149,11 +197,18 @@ using log_s = sequence::periodic_n<1, 0, 1, end_time>;
 using spawn_s = sequence::multiple_n<devices, 0>;
 //! @brief The distribution of initial node positions (random in a given rectangle).
 using rectangle_d = distribution::rect_n<1, 0, 0, 0, side, side, height>;
+//! @brief The distribution of the side of the walked area (fixed).
+using area_d = distribution::constant_n<double, side>;
 //! @brief The distribution of node speeds (all equal to a fixed value).
 using speed_d = distribution::constant_i<double, speed>;
+//! @brief The distribution of the snapshot board (one for the whole network).
+using board_d = snapshot::shared_board<snapshot::device_state<3>>;
+//! @brief The distribution of the mobility engine (one for the whole network).
+using engine_d = mobility::shared_engine<3>;
 //! @brief The contents of the node storage as tags and associated types.
 using store_t = tuple_store<
     speed,              double,
+    area_side,          double,
     true_distance,      double,
     calc_distance,      double,
     source_diameter,    double,
@@ -162,9 +217,11 @@ using store_t = tuple_store<
     source_diameter_c,  color,
     diameter_c,         color,
     node_shape,         shape,
-    node_size,          double
+    node_size,          double,
+    snapshot_board,     std::shared_ptr<snapshot::board<snapshot::device_state<3>>>,
+    walk_engine,        std::shared_ptr<mobility::engine<3>>
 >;
-//! @brief The tags and corresponding aggregators to be logged.
+//! @brief The tags and corresponding aggregators to be logged (true_distance is measured from the position of the source extrapolated from its last round, which is exact).
 using aggregator_t = aggregators<
     true_distance,      aggregator::max<double>,
     diameter,           aggregator::combine<
@@ -185,29 +242,40 @@ using speed_plot_t = plot::split<speed, plot::filter<plot::time, filter::above<5
 using plot_t = plot::join<time_plot_t, speed_plot_t>;
 
 
-//! @brief The general simulation options.
-DECLARE_OPTIONS(list,
+//! @brief The retention of messages for quiescent_main (at least the maximum interval between rounds).
+using quiescent_retain_t = metric::retain<max_backoff+1, 1>;
+
+
+//! @brief The general simulation options, logging rows into a plotter of type P and running program M, retaining messages by metric R.
+template <typename P, typename M = coordination::main, typename R = metric::once>
+DECLARE_OPTIONS(plotted_list,
     parallel<false>,     // no multithreading on node rounds
     synchronised<false>, // optimise for asynchronous networks
-    program<coordination::main>,   // program to be run (refers to MAIN above)
+    program<M>,                    // program to be run (MAIN above by default)
     exports<coordination::main_t>, // export type list (types used in messages)
+    retain<R>,               // the metric for retaining messages from neighbours
     round_schedule<round_s>, // the sequence generator for round events on nodes
     log_schedule<log_s>,     // the sequence generator for log events on the network
     spawn_schedule<spawn_s>, // the sequence generator of node creation events on the network
     store_t,       // the contents of the node storage
     aggregator_t,  // the tags and corresponding aggregators to be logged
     init<
-        x,      rectangle_d, // initialise position randomly in a rectangle for new nodes
-        speed,  speed_d      // initialise speed with the globally provided speed for new nodes
+        x,              rectangle_d, // initialise position randomly in a rectangle for new nodes
+        speed,          speed_d,     // initialise speed with the globally provided speed for new nodes
+        area_side,      area_d,      // walk in the whole deployment area
+        snapshot_board, board_d,     // share a single snapshot board in the network
+        walk_engine,    engine_d     // share a single mobility engine in the network
     >,
     extra_info<speed, double>, // use the globally provided speed for plotting
-    plot_type<plot_t>,         // the plot description to be used
+    plot_type<P>,              // the plot description to be used
     dimension<dim>, // dimensionality of the space
     connector<connect::fixed<comm, 1, dim>>, // connection allowed within a fixed comm range
     shape_tag<node_shape>, // the shape of a node is read from this tag in the store
     size_tag<node_size>,   // the size of a node is read from this tag in the store
     color_tag<distance_c, source_diameter_c, diameter_c> // colors of a node are read from these
 );
+//! @brief The general simulation options.
+using list = plotted_list<plot_t>;
 
 
 } // namespace option
@@ -0,0 +1,203 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file spreading_collection_compare.hpp
+ * @brief Comparison of alternative main programs of the spreading collection case study.
+ *
+ * Programs are wrapped by `tracked`, which counts rounds. Every time unit, right before logging,
+ * the error of the distance held by every device is computed against its true distance at that
+ * time (so that devices skipping rounds are measured on the values they hold meanwhile), and both
+ * are logged through aggregators into a `compare::series`. The `compare::main` function runs two
+ * programs on the same seeds for every speed, and reports the series of every run.
+ */
+
+#ifndef FCPP_SPREADING_COLLECTION_COMPARE_H_
+#define FCPP_SPREADING_COLLECTION_COMPARE_H_
+
+#include <cmath>
+#include <cstdlib>
+#include <ostream>
+#include <vector>
+
+#include "lib/spreading_collection.hpp"
+#include "lib/sweep.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the libraries of coordination routines.
+namespace coordination {
+
+
+//! @brief Tags used in the node storage.
+namespace tags {
+    //! @brief Number of rounds performed by the node.
+    struct rounds {};
+    //! @brief Error of the distance held by the node at the last logging time.
+    struct calc_error {};
+}
+
+
+//! @brief Program wrapper running `M`, and counting its rounds.
+template <typename M>
+struct tracked {
+    //! @brief Executes a round of the wrapped program.
+    template <typename node_t>
+    void operator()(node_t& node, times_t t) {
+        M{}(node, t);
+        node.storage(tags::rounds{}) += 1;
+    }
+};
+
+
+}
+
+
+//! @brief Namespace containing the comparison of main programs.
+namespace compare {
+
+
+//! @brief Plotter collecting the logged total rounds and mean distance error, by time unit.
+struct series {
+    //! @brief Total rounds performed up to every time unit.
+    std::vector<double> rounds;
+    //! @brief Distance error averaged over devices in every time unit.
+    std::vector<double> error;
+
+    //! @brief Adds a row.
+    template <typename R>
+    series& operator<<(R const& row) {
+        std::vector<double> k, v;
+        sweep::details::row_split<R, component::tags::plot::time>::split(row, k, v);
+        rounds.push_back(v[0]);
+        error.push_back(v[1]);
+        return *this;
+    }
+
+    //! @brief Distance error averaged over time and devices.
+    double mean_error() const {
+        double e = 0;
+        for (double x : error) e += x / error.size();
+        return e;
+    }
+};
+
+
+}
+
+
+//! @brief Namespace for component options.
+namespace option {
+
+
+//! @brief The storage tracking rounds and errors.
+using tracked_store_t = tuple_store<
+    rounds,     size_t,
+    calc_error, double
+>;
+
+//! @brief The tracked values and corresponding aggregators to be logged.
+using tracked_aggregator_t = aggregators<
+    rounds,     aggregator::sum<size_t>,
+    calc_error, aggregator::mean<double>
+>;
+
+//! @brief The options running program `M` with retention metric `R`, logging into a `compare::series`.
+template <typename M, typename R = metric::once>
+DECLARE_OPTIONS(tracked_list,
+    parallel<false>,
+    synchronised<false>,
+    program<coordination::tracked<M>>,
+    exports<coordination::main_t>,
+    retain<R>,
+    round_schedule<round_s>,
+    log_schedule<log_s>,
+    spawn_schedule<spawn_s>,
+    store_t,
+    tracked_store_t,
+    tracked_aggregator_t,
+    init<
+        x,              rectangle_d,
+        speed,          speed_d,
+        area_side,      area_d,
+        snapshot_board, board_d,
+        walk_engine,    engine_d
+    >,
+    plot_type<compare::series>,
+    dimension<dim>,
+    connector<connect::fixed<comm, 1, dim>>
+);
+
+
+}
+
+
+//! @brief Namespace containing the comparison of main programs.
+namespace compare {
+
+
+/**
+ * @brief Stores into every device the error at time `t` of the distance it holds.
+ *
+ * The true distance is measured between the positions at `t` of the device and of the source selected at `t`.
+ */
+template <typename N>
+void track_errors(N& network, times_t t) {
+    device_t src = int(t) / source_period;
+    bool present = network.node_count(src);
+    vec<3> src_pos = present ? network.node_at(src).position(t) : vec<3>{};
+    for (device_t i = 0; i < network.node_size(); ++i) if (network.node_count(i)) {
+        auto& n = network.node_at(i);
+        real_t d = n.storage(coordination::tags::calc_distance{});
+        real_t r = present ? distance(n.position(t), src_pos) : 0;
+        // unreached devices are as wrong as they can be
+        n.storage(coordination::tags::calc_error{}) = std::isfinite(d) ? std::abs(d - r) : side + height;
+    }
+}
+
+//! @brief Runs the case study with given options for a speed and seed, returning the logged series.
+template <typename O>
+series measure(size_t speed, size_t seed) {
+    series s;
+    std::ostream null_stream(nullptr);
+    typename component::batch_simulator<O>::net network{common::make_tagged_tuple<option::output, option::plotter, option::seed, option::speed>(&null_stream, &s, seed, speed)};
+    // errors are computed before every event following a logging time (the logging included)
+    times_t t = 0;
+    while (network.next() < TIME_MAX) {
+        for (; t <= end_time and network.next() >= t; ++t) track_errors(network, t);
+        network.update();
+    }
+    return s;
+}
+
+/**
+ * @brief Entry point of a comparison executable.
+ *
+ * Usage: `<executable> [seeds]` (seeds default to 3). For every speed, runs options `A` and `B`
+ * on the same seeds, and calls `f(speed, a, b)` with the vectors of series of every seed.
+ */
+template <typename A, typename B, typename F>
+int main(int argc, char** argv, F&& f) {
+    size_t seeds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 3;
+    for (size_t speed = 0; speed <= comm/2; speed += comm/10) {
+        std::vector<series> a, b;
+        for (size_t seed = 0; seed < seeds; ++seed) {
+            a.push_back(measure<A>(speed, seed));
+            b.push_back(measure<B>(speed, seed));
+        }
+        f(speed, a, b);
+    }
+    return 0;
+}
+
+
+}
+
+
+}
+
+#endif // FCPP_SPREADING_COLLECTION_COMPARE_H_
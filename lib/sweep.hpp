@@ -0,0 +1,213 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file sweep.hpp
+ * @brief Parallel execution of parameter sweeps of independent simulations.
+ *
+ * Independent jobs (as the simulations of a sweep) are distributed by `parallel_for` to a pool of
+ * worker threads with work stealing. The logged rows can be folded by a `reducer` into running means
+ * as they arrive, so that memory is proportional to the size of the plots rather than to the logged
+ * rows, and forwarded to multiple plotters through `tee`.
+ */
+
+#ifndef FCPP_SWEEP_H_
+#define FCPP_SWEEP_H_
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "lib/fcpp.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the parallel sweep executor.
+namespace sweep {
+
+
+//! @brief The default number of threads (the available hardware concurrency).
+inline size_t default_threads() {
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+
+/**
+ * @brief Calls `f(i, w)` for every `i` in `[0, n)` on a pool of `threads` workers (`w` is the worker index).
+ *
+ * Every worker starts from a contiguous slice of indices and, once it is exhausted,
+ * steals indices from the slices of the other workers.
+ */
+template <typename F>
+void parallel_for(size_t n, size_t threads, F&& f) {
+    threads = std::max<size_t>(std::min(threads, n), 1);
+    // slice boundaries and next index to be taken in each slice
+    std::vector<size_t> end(threads);
+    std::vector<std::atomic<size_t>> next(threads);
+    for (size_t w = 0; w < threads; ++w) {
+        next[w] = n * w / threads;
+        end[w] = n * (w+1) / threads;
+    }
+    auto worker = [&](size_t w) {
+        for (size_t k = 0; k < threads; ++k) {
+            size_t v = (w + k) % threads;
+            for (size_t i = next[v]++; i < end[v]; i = next[v]++) f(i, w);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t w = 1; w < threads; ++w) pool.emplace_back(worker, w);
+    worker(0);
+    for (auto& t : pool) t.join();
+}
+
+
+//! @brief Plotter forwarding rows to two other plotters.
+template <typename A, typename B>
+struct tee {
+    //! @brief The first plotter.
+    A* first;
+    //! @brief The second plotter.
+    B* second;
+
+    //! @brief Forwards a row.
+    template <typename R>
+    tee& operator<<(R const& row) {
+        *first << row;
+        *second << row;
+        return *this;
+    }
+};
+
+
+//! @brief Namespace of implementation details.
+namespace details {
+    //! @brief Helper class splitting rows of a given type into keys (tags in Ks) and values.
+    template <typename R, typename... Ks>
+    struct row_split;
+
+    //! @brief Helper class splitting rows of a given type into keys (tags in Ks) and values (tagged tuple specialisation).
+    template <typename... Ss, typename... Ts, typename... Ks>
+    struct row_split<common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>>, Ks...> {
+        //! @brief The row type.
+        using row_type = common::tagged_tuple<common::type_sequence<Ss...>, common::type_sequence<Ts...>>;
+
+        //! @brief Whether a tag is a key.
+        template <typename S>
+        static constexpr bool key() {
+            bool b[] = {false, std::is_same<S, Ks>::value...};
+            for (bool x : b) if (x) return true;
+            return false;
+        }
+
+        //! @brief Splits a row into keys and values.
+        static void split(row_type const& row, std::vector<double>& k, std::vector<double>& v) {
+            int unused[] = {0, ((key<Ss>() ? k : v).push_back(double(common::get<Ss>(row))), 0)...};
+            (void)unused;
+        }
+
+        //! @brief Joins keys and values into a row.
+        static row_type join(std::vector<double> const& k, std::vector<double> const& v) {
+            row_type row;
+            size_t i = 0, j = 0;
+            int unused[] = {0, (common::get<Ss>(row) = Ts(key<Ss>() ? k[i++] : v[j++]), 0)...};
+            (void)unused;
+            return row;
+        }
+    };
+
+    //! @brief Recognises mean aggregators.
+    template <typename T>
+    std::true_type is_mean(aggregator::mean<T>*);
+
+    //! @brief Recognises other aggregators.
+    template <typename A>
+    std::false_type is_mean(A*);
+
+    //! @brief Whether every aggregator in a type sequence is a mean.
+    template <typename A>
+    struct all_means;
+
+    //! @brief Whether every aggregator in a type sequence is a mean (type sequence specialisation).
+    template <typename... As>
+    struct all_means<common::type_sequence<As...>> {
+        //! @brief The result.
+        static constexpr bool value() {
+            bool b[] = {true, decltype(is_mean(static_cast<As*>(nullptr)))::value...};
+            for (bool x : b) if (not x) return false;
+            return true;
+        }
+    };
+}
+
+
+/**
+ * @brief Plotter folding rows with the same keys (tags Ks) into running means, to be emitted into a plotter of type `P`.
+ *
+ * Emitting a group of `n` rows produces `n` copies of their mean row, so that the result is exact
+ * only for plots aggregating rows through means, while memory is proportional to the number of
+ * distinct keys. The row aggregators used by the plots of `P` (the second argument of `plot::values`)
+ * are given as type sequence `A`, and required to be all `aggregator::mean`. Reducers can be emitted
+ * at any time (e.g. to produce a partial plot). Rows are expected to be all of the same type.
+ */
+template <typename P, typename A, typename... Ks>
+class reducer {
+    static_assert(details::all_means<A>::value(), "rows can be reduced only for plots aggregating rows through means");
+
+  public:
+    //! @brief Folds a row.
+    template <typename R>
+    reducer& operator<<(R const& row) {
+        using io = details::row_split<R, Ks...>;
+        if (not m_emit) m_emit = [](std::vector<double> const& k, std::vector<double> const& v, P& p) {
+            p << io::join(k, v);
+        };
+        std::vector<double> k, v;
+        io::split(row, k, v);
+        group& g = m_groups[k];
+        g.mean.resize(v.size(), 0);
+        ++g.count;
+        for (size_t i = 0; i < v.size(); ++i) g.mean[i] += (v[i] - g.mean[i]) / g.count;
+        return *this;
+    }
+
+    //! @brief Feeds the folded rows into a plotter.
+    void emit(P& p) const {
+        if (m_emit) for (auto const& x : m_groups)
+            for (size_t i = 0; i < x.second.count; ++i) m_emit(x.first, x.second.mean, p);
+    }
+
+    //! @brief Number of distinct keys.
+    size_t size() const {
+        return m_groups.size();
+    }
+
+  private:
+    //! @brief Running mean of a group of rows.
+    struct group {
+        //! @brief Number of rows.
+        size_t count = 0;
+        //! @brief Mean of the values.
+        std::vector<double> mean;
+    };
+
+    //! @brief The groups by key.
+    std::map<std::vector<double>, group> m_groups;
+    //! @brief Feeds a row given keys and values into a plotter (set by the first row).
+    std::function<void(std::vector<double> const&, std::vector<double> const&, P&)> m_emit;
+};
+
+
+}
+
+
+}
+
+#endif // FCPP_SWEEP_H_
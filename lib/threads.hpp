@@ -0,0 +1,39 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file threads.hpp
+ * @brief Number of threads running node rounds, chosen at startup.
+ */
+
+#ifndef FCPP_THREADS_H_
+#define FCPP_THREADS_H_
+
+#include <cstdlib>
+#include <thread>
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+/**
+ * @brief The number of threads to be used by simulations with `parallel<true>`.
+ *
+ * It is read from the `FCPP_THREADS` environment variable if set to a positive number,
+ * and defaults to the available hardware concurrency. It is meant to be passed to the
+ * network through the `threads` initialisation tag.
+ */
+inline size_t runtime_threads() {
+    char const* s = std::getenv("FCPP_THREADS");
+    size_t n = s ? std::strtoull(s, nullptr, 10) : 0;
+    if (n > 0) return n;
+    n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+
+}
+
+#endif // FCPP_THREADS_H_
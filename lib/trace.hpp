@@ -0,0 +1,277 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file trace.hpp
+ * @brief Binary tracing of values computed by aggregate programs.
+ *
+ * Tracing is enabled by compiling with `FCPP_TRACE=1`, otherwise the tracing macros expand
+ * to nothing (and their arguments are not evaluated). When enabled, every thread writes
+ * fixed-size binary records into its own lock-free ring buffer, and a background thread
+ * drains the buffers into the file named by the `FCPP_TRACE_FILE` environment variable
+ * (`trace.bin` by default). The `trace_decode` tool converts the file to text.
+ *
+ * File format: the `magic` header, a sequence of `record` objects terminated by a record
+ * of kind `end` (whose `value` is the number of records dropped due to full buffers), and
+ * the table of names as a `uint32_t` count followed by `uint32_t` lengths and characters.
+ */
+
+#ifndef FCPP_TRACE_H_
+#define FCPP_TRACE_H_
+
+#ifndef FCPP_TRACE
+//! @brief Whether tracing is enabled.
+#define FCPP_TRACE 0
+#endif
+
+#include <cstdint>
+
+#if FCPP_TRACE
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/data.hpp"
+#endif
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+//! @brief Namespace containing the binary tracing facility.
+namespace trace {
+
+
+//! @brief Magic number at the start of a trace file.
+constexpr char magic[8] = {'F','C','P','P','T','R','C','1'};
+
+//! @brief Kinds of trace records.
+enum class kind : uint32_t {
+    //! @brief A scalar value.
+    value,
+    //! @brief The value of a field for a neighbour.
+    field,
+    //! @brief The default value of a field.
+    other,
+    //! @brief A named marker with no value.
+    mark,
+    //! @brief The end of the records.
+    end
+};
+
+//! @brief A binary trace record.
+struct record {
+    //! @brief The time of the round.
+    double time;
+    //! @brief The traced value.
+    double value;
+    //! @brief The device performing the round.
+    uint32_t uid;
+    //! @brief The neighbour (for field records).
+    uint32_t nbr;
+    //! @brief The index of the name of the value.
+    uint32_t key;
+    //! @brief The kind of record.
+    kind type;
+};
+
+
+#if FCPP_TRACE
+
+//! @brief Single-producer single-consumer ring buffer of records.
+class ring {
+  public:
+    //! @brief Number of records in the buffer.
+    static constexpr size_t capacity = 1 << 16;
+
+    //! @brief Pushes a record (from the owning thread), returning false if full.
+    bool push(record const& r) {
+        size_t h = m_head.load(std::memory_order_relaxed);
+        if (h - m_tail.load(std::memory_order_acquire) == capacity) return false;
+        m_data[h % capacity] = r;
+        m_head.store(h+1, std::memory_order_release);
+        return true;
+    }
+
+    //! @brief Pops every available record into a file (from the draining thread).
+    size_t drain(FILE* f) {
+        size_t t = m_tail.load(std::memory_order_relaxed);
+        size_t h = m_head.load(std::memory_order_acquire);
+        for (size_t i = t; i < h; ++i) fwrite(&m_data[i % capacity], sizeof(record), 1, f);
+        m_tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+
+  private:
+    //! @brief The records.
+    std::array<record, capacity> m_data;
+    //! @brief Index of the next record to be written.
+    alignas(64) std::atomic<size_t> m_head{0};
+    //! @brief Index of the next record to be read.
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+//! @brief The tracer singleton, owning the ring buffers and the draining thread.
+class tracer {
+  public:
+    //! @brief Accesses the singleton.
+    static tracer& get() {
+        static tracer t;
+        return t;
+    }
+
+    //! @brief The ring buffer of the current thread.
+    ring& local() {
+        thread_local std::shared_ptr<ring> r = attach();
+        return *r;
+    }
+
+    //! @brief Registers a name, returning its index.
+    uint32_t key(std::string const& name) {
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_names.push_back(name);
+        return m_names.size() - 1;
+    }
+
+    //! @brief Counts a dropped record.
+    void drop() {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+  private:
+    //! @brief Opens the trace file and starts the draining thread.
+    tracer() {
+        char const* path = std::getenv("FCPP_TRACE_FILE");
+        m_file = fopen(path ? path : "trace.bin", "wb");
+        if (m_file) fwrite(magic, sizeof(magic), 1, m_file);
+        m_thread = std::thread([this](){
+            while (not m_stop.load()) {
+                if (drain() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        });
+    }
+
+    //! @brief Stops the draining thread, and writes the remaining records and the name table.
+    ~tracer() {
+        m_stop = true;
+        m_thread.join();
+        drain();
+        if (not m_file) return;
+        record e{0, double(m_dropped.load()), 0, 0, 0, kind::end};
+        fwrite(&e, sizeof(record), 1, m_file);
+        uint32_t n = m_names.size();
+        fwrite(&n, sizeof(uint32_t), 1, m_file);
+        for (std::string const& s : m_names) {
+            uint32_t l = s.size();
+            fwrite(&l, sizeof(uint32_t), 1, m_file);
+            fwrite(s.data(), 1, l, m_file);
+        }
+        fclose(m_file);
+    }
+
+    //! @brief Creates and registers a ring buffer.
+    std::shared_ptr<ring> attach() {
+        std::shared_ptr<ring> r = std::make_shared<ring>();
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_rings.push_back(r);
+        return r;
+    }
+
+    //! @brief Drains every ring buffer into the file.
+    size_t drain() {
+        std::vector<std::shared_ptr<ring>> rings;
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            rings = m_rings;
+        }
+        size_t n = 0;
+        if (m_file) for (auto& r : rings) n += r->drain(m_file);
+        return n;
+    }
+
+    //! @brief The trace file.
+    FILE* m_file;
+    //! @brief The ring buffers of every thread (kept after the thread exits, until drained).
+    std::vector<std::shared_ptr<ring>> m_rings;
+    //! @brief The registered names.
+    std::vector<std::string> m_names;
+    //! @brief Guards the ring buffers and names.
+    std::mutex m_mutex;
+    //! @brief Number of dropped records.
+    std::atomic<size_t> m_dropped{0};
+    //! @brief Whether the draining thread should stop.
+    std::atomic<bool> m_stop{false};
+    //! @brief The draining thread.
+    std::thread m_thread;
+};
+
+//! @brief Registers a name, returning its index.
+inline uint32_t key(char const* name) {
+    return tracer::get().key(name);
+}
+
+//! @brief Writes a record into the buffer of the current thread.
+inline void push(record const& r) {
+    if (not tracer::get().local().push(r)) tracer::get().drop();
+}
+
+//! @brief Traces a marker.
+inline void mark(uint32_t k, double t, device_t uid) {
+    push({t, 0, uint32_t(uid), 0, k, kind::mark});
+}
+
+//! @brief Traces a scalar value.
+template <typename T>
+void value(uint32_t k, double t, device_t uid, T const& v) {
+    push({t, double(v), uint32_t(uid), 0, k, kind::value});
+}
+
+//! @brief Traces a field value (one record per neighbour, and one for the default).
+template <typename T>
+void value(uint32_t k, double t, device_t uid, field<T> const& f) {
+    auto const& ids = details::get_ids(f);
+    auto const& vals = details::get_vals(f);
+    for (size_t i = 0; i < ids.size(); ++i)
+        push({t, double(vals[i]), uint32_t(uid), uint32_t(ids[i]), k, kind::field});
+    push({t, double(details::other(f)), uint32_t(uid), 0, k, kind::other});
+}
+
+#endif
+
+
+}
+
+
+}
+
+
+#if FCPP_TRACE
+//! @brief Traces the value of an expression in the current round of `node`.
+#define TRACE_VALUE(v)                                                                  \
+    do {                                                                                \
+        static uint32_t const fcpp_trace_key = ::fcpp::trace::key(#v);                  \
+        ::fcpp::trace::value(fcpp_trace_key, node.current_time(), node.uid, v);         \
+    } while (0)
+//! @brief Traces a named marker in the current round of `node`.
+#define TRACE_MARK(s)                                                                   \
+    do {                                                                                \
+        static uint32_t const fcpp_trace_key = ::fcpp::trace::key(s);                   \
+        ::fcpp::trace::mark(fcpp_trace_key, node.current_time(), node.uid);             \
+    } while (0)
+#else
+//! @brief Traces the value of an expression in the current round of `node` (disabled).
+#define TRACE_VALUE(v)  do {} while (0)
+//! @brief Traces a named marker in the current round of `node` (disabled).
+#define TRACE_MARK(s)   do {} while (0)
+#endif
+
+#endif // FCPP_TRACE_H_
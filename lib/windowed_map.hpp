@@ -0,0 +1,102 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file windowed_map.hpp
+ * @brief Associative container forgetting entries after a given time window.
+ */
+
+#ifndef FCPP_WINDOWED_MAP_H_
+#define FCPP_WINDOWED_MAP_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+#include "lib/settings.hpp"
+
+
+/**
+ * @brief Namespace containing all the objects in the FCPP library.
+ */
+namespace fcpp {
+
+
+/**
+ * @brief Map from keys to values, forgetting entries inserted more than a time window ago.
+ *
+ * Entries are stored in a ring of `G` generations, each spanning `window / (G-1)` time units.
+ * Advancing the time clears the generations that became too old, so that an entry is
+ * kept for at least `window` and at most `window * G / (G-1)` time units. Memory is thus
+ * bounded by the number of insertions within a window, regardless of the total time.
+ */
+template <typename K, typename V, size_t G = 4>
+class windowed_map {
+    static_assert(G > 1, "at least two generations are needed");
+
+  public:
+    //! @brief Empty constructor (infinite window, never forgetting entries).
+    windowed_map() = default;
+
+    //! @brief Constructor with a given time window.
+    windowed_map(times_t window) : m_span(window / (G-1)) {}
+
+    //! @brief Equality operator.
+    bool operator==(windowed_map const& o) const {
+        return m_span == o.m_span and m_epoch == o.m_epoch and m_gens == o.m_gens;
+    }
+
+    //! @brief Forgets entries which are older than the window at a given time.
+    void advance(times_t t) {
+        long long epoch = m_span > 0 ? (long long)std::floor(t / m_span) : 0;
+        for (long long e = std::max(m_epoch, epoch - (long long)G) + 1; e <= epoch; ++e)
+            m_gens[e % G].clear();
+        m_epoch = std::max(m_epoch, epoch);
+    }
+
+    //! @brief Number of occurrences of a key in the map (0 or 1).
+    size_t count(K const& k) const {
+        for (auto const& g : m_gens) if (g.count(k)) return 1;
+        return 0;
+    }
+
+    //! @brief Inserts an entry in the current generation (overwriting older ones).
+    void insert(K const& k, V const& v) {
+        for (auto& g : m_gens) g.erase(k);
+        m_gens[m_epoch % G][k] = v;
+    }
+
+    //! @brief Number of entries in the map.
+    size_t size() const {
+        size_t n = 0;
+        for (auto const& g : m_gens) n += g.size();
+        return n;
+    }
+
+    //! @brief Serialises the content from/to a given input/output stream.
+    template <typename S>
+    S& serialize(S& s) {
+        return s & m_span & m_epoch & m_gens;
+    }
+
+    //! @brief Serialises the content from/to a given input/output stream (const overload).
+    template <typename S>
+    S& serialize(S& s) const {
+        return s << m_span << m_epoch << m_gens;
+    }
+
+  private:
+    //! @brief The time span of a generation.
+    times_t m_span = 0;
+
+    //! @brief The index of the current generation.
+    long long m_epoch = 0;
+
+    //! @brief The ring of generations.
+    std::array<std::unordered_map<K, V>, G> m_gens;
+};
+
+
+}
+
+#endif // FCPP_WINDOWED_MAP_H_
@@ -8,6 +8,8 @@
 // [INTRODUCTION]
 //! Importing the FCPP library.
 #include "lib/fcpp.hpp"
+#include "lib/obstacle_index.hpp"
+#include "lib/threads.hpp"
 
 /**
  * @brief Namespace containing all the objects in the FCPP library.
@@ -57,6 +59,19 @@ namespace tags {
 }
 
 
+/**
+ * @brief Index of the obstacles of the network, built on first use (one cell per unit of space).
+ *
+ * The index is shared by every node of type `node_t`, and thus assumes a single network per
+ * process (as in this simulation): networks with different obstacles need their own node types.
+ */
+template <typename node_t>
+obstacle_index const& obstacles(node_t& node) {
+    static obstacle_index const index(node.net, 0, 0, width, height, 1);
+    return index;
+}
+
+
 //! @brief Main function.
 MAIN() {
 
@@ -66,8 +81,8 @@ MAIN() {
 
     // used to set position of out of bound nodes at the start
     if (coordination::counter(CALL) == 1) {
-        if (node.net.is_obstacle(node.position())) {
-            auto p2 = node.net.closest_space(node.position());
+        if (obstacles(node).is_obstacle(node.position())) {
+            auto p2 = obstacles(node).closest_space(node.position());
             int deltaX, deltaY, size = node.storage(tags::node_size{});
             if((p2 - node.position())[0] > 0) deltaX = +size; else deltaX = -size;
             if((p2 - node.position())[1] > 0) deltaY = +size; else deltaY = -size;
@@ -75,7 +90,7 @@ MAIN() {
         }
     }
 
-    auto closest = node.net.closest_obstacle(node.position());
+    auto closest = obstacles(node).closest_obstacle(node.position());
     real_t dist1 = distance(closest, node.position());
     real_t min_neighbor_dist = min_hood(CALL, node.nbr_dist(),std::numeric_limits<real_t>::max());
 
@@ -83,29 +98,16 @@ MAIN() {
     node.storage(tags::distance_from_obstacle{}) = dist1;
     node.storage(tags::distance_min_nbr{}) = min_neighbor_dist;
 
-    if (dist1 <= 30) {
+    // near obstacles or crowds, devices stop and are pushed away by elastic forces
+    bool near_obstacle = dist1 <= 30;
+    bool crowded = min_neighbor_dist <= 25;
+    node.propulsion() = make_vec(0,0,0);
+    if (near_obstacle or crowded) {
         node.velocity() = make_vec(0,0,0);
-        node.propulsion() = make_vec(0,0,0);
-        node.propulsion() += -coordination::point_elastic_force(CALL,closest,1,0.10);
-        if (min_neighbor_dist <= 25) {
-            node.velocity() = make_vec(0,0,0);
-            node.propulsion() += -coordination::neighbour_elastic_force(CALL, 0.05, 0.05);
-        }
+        if (near_obstacle) node.propulsion() -= coordination::point_elastic_force(CALL,closest,1,0.10);
+        if (crowded) node.propulsion() -= coordination::neighbour_elastic_force(CALL, 0.05, 0.05);
     }
-    else {
-        if (min_neighbor_dist <= 25) {
-            node.propulsion() = make_vec(0,0,0);
-            node.velocity() = make_vec(0,0,0);
-            node.propulsion() += -coordination::neighbour_elastic_force(CALL, 0.05, 0.05);
-        }
-        else {
-            node.propulsion() = make_vec(0,0,0);
-            rectangle_walk(CALL, make_vec(0, 0, tall), make_vec(width, height, tall), node.storage(tags::speed{}), 1);
-        }
-    }
-
-
-
+    else rectangle_walk(CALL, make_vec(0, 0, tall), make_vec(width, height, tall), node.storage(tags::speed{}), 1);
 }
 //! @brief Export types used by the main function (update it when expanding the program).
 FUN_EXPORT main_t = common::export_list<double, int, rectangle_walk_t<dim>>;
@@ -193,7 +195,7 @@ int main() {
     //! @brief The network object type (interactive simulator with given options).
     using net_t = component::interactive_simulator<option::list>::net;
     //! @brief The initialisation values (simulation name).
-    auto init_v = common::make_tagged_tuple<option::name, option::texture, option::obstacles, option::speed, option::obstacles_color_threshold>("Simulated map test", "apartment.jpg", "apartment.jpg", 3, 0.8);
+    auto init_v = common::make_tagged_tuple<option::name, option::texture, option::obstacles, option::speed, option::obstacles_color_threshold, option::threads>("Simulated map test", "apartment.jpg", "apartment.jpg", 3, 0.8, runtime_threads());
     //! @brief Construct the network object.
     net_t network{init_v};
     //! @brief Run the simulation until exit.
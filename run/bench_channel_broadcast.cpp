@@ -0,0 +1,66 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file bench_channel_broadcast.cpp
+ * @brief Scaling benchmark of the channel broadcast case study.
+ */
+
+#include "lib/fcpp.hpp"
+#include "lib/channel_broadcast.hpp"
+#include "lib/bench.hpp"
+
+using namespace fcpp;
+using namespace component::tags;
+using namespace coordination::tags;
+
+constexpr size_t dim = 3;
+
+//! @brief The benchmark options for `n` devices (sequential unless `par`).
+template <size_t n, bool par = false, bool sync = false>
+DECLARE_OPTIONS(opt,
+    parallel<par>,
+    synchronised<sync>,
+    program<bench::program<coordination::main>>,
+    exports<coordination::main_t>,
+    round_schedule<bench::round_s>,
+    spawn_schedule<sequence::multiple_n<n, 0>>,
+    tuple_store<
+        in_channel,         bool,
+        source_distance,    double,
+        dest_distance,      double,
+        distance_c,         color,
+        size,               double,
+        node_shape,         shape,
+        area_side,          double
+    >,
+    bench::store_t,
+    init<
+        x,                  distribution::rect_n<1, 0, 0, 0, bench::side(n), bench::side(n), height>,
+        area_side,          distribution::constant_n<double, bench::side(n)>
+    >,
+    dimension<dim>,
+    connector<connect::discovery<connect::fixed<comm, 1, dim>>>,
+    message_size<true>
+);
+
+//! @brief The benchmark component for `n` devices.
+template <size_t n>
+using comp_t = component::batch_simulator<opt<n>>;
+
+//! @brief The thread-scaling benchmark component, for a given `synchronised` option.
+template <bool sync>
+using threads_comp_t = component::batch_simulator<opt<bench::threads_size, true, sync>>;
+
+//! @brief The performance regression and autotuning component, for a combination `O` of options.
+template <int O>
+using perf_comp_t = component::batch_simulator<bench::perf_options<O, opt<bench::perf_size, (O & 8) == 8, (O & 16) == 16>>>;
+
+int main(int argc, char** argv) {
+    if (argc > 1 and std::string(argv[1]) == "perf")
+        return bench::perf_main<perf_comp_t>(argc, argv, "channel_broadcast");
+    if (argc > 1 and std::string(argv[1]) == "tune")
+        return bench::tune_main<perf_comp_t>(argc, argv, "channel_broadcast");
+    if (argc > 1 and std::string(argv[1]) == "threads")
+        return bench::threads_main<threads_comp_t>(argc, argv, "channel_broadcast");
+    return bench::main<comp_t>(argc, argv, "channel_broadcast");
+}
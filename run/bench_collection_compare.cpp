@@ -0,0 +1,69 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file bench_collection_compare.cpp
+ * @brief Scaling benchmark of the collection compare case study.
+ */
+
+#include "lib/fcpp.hpp"
+#include "lib/collection_compare.hpp"
+#include "lib/bench.hpp"
+
+using namespace fcpp;
+using namespace component::tags;
+using namespace coordination::tags;
+
+//! @brief The benchmark options for `n` devices (along a strip with the density of the case study, sequential unless `par`).
+template <size_t n, bool par = false, bool sync = false>
+DECLARE_OPTIONS(opt,
+    parallel<par>,
+    synchronised<sync>,
+    program<bench::program<coordination::main>>,
+    exports<coordination::main_t>,
+    round_schedule<bench::round_s>,
+    spawn_schedule<sequence::multiple_n<n, 0>>,
+    tuple_store<
+        algorithm,      int,
+        spc_sum,        double,
+        mpc_sum,        double,
+        wmpc_sum,       double,
+        ideal_sum,      double,
+        spc_max,        double,
+        mpc_max,        double,
+        wmpc_max,       double,
+        ideal_max,      double,
+        area_length,    double,
+        snapshot_board, std::shared_ptr<snapshot::board<snapshot::device_state<2>>>
+    >,
+    bench::store_t,
+    init<
+        x,              distribution::rect_n<1, 0, 0, 2*n, 200>,
+        area_length,    distribution::constant_n<double, 2*n>,
+        algorithm,      distribution::constant_n<int, 1>,
+        snapshot_board, snapshot::shared_board<snapshot::device_state<2>>
+    >,
+    connector<connect::discovery<connect::fixed<100>>>,
+    message_size<true>
+);
+
+//! @brief The benchmark component for `n` devices.
+template <size_t n>
+using comp_t = component::batch_simulator<opt<n>>;
+
+//! @brief The thread-scaling benchmark component, for a given `synchronised` option.
+template <bool sync>
+using threads_comp_t = component::batch_simulator<opt<bench::threads_size, true, sync>>;
+
+//! @brief The performance regression and autotuning component, for a combination `O` of options.
+template <int O>
+using perf_comp_t = component::batch_simulator<bench::perf_options<O, opt<bench::perf_size, (O & 8) == 8, (O & 16) == 16>>>;
+
+int main(int argc, char** argv) {
+    if (argc > 1 and std::string(argv[1]) == "perf")
+        return bench::perf_main<perf_comp_t>(argc, argv, "collection_compare");
+    if (argc > 1 and std::string(argv[1]) == "tune")
+        return bench::tune_main<perf_comp_t>(argc, argv, "collection_compare");
+    if (argc > 1 and std::string(argv[1]) == "threads")
+        return bench::threads_main<threads_comp_t>(argc, argv, "collection_compare");
+    return bench::main<comp_t>(argc, argv, "collection_compare");
+}
@@ -0,0 +1,91 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file bench_message_dispatch.cpp
+ * @brief Scaling benchmark of the message dispatch case study.
+ */
+
+#include "lib/fcpp.hpp"
+#include "lib/message_dispatch.hpp"
+#include "lib/bench.hpp"
+
+using namespace fcpp;
+using namespace component::tags;
+using namespace coordination::tags;
+
+constexpr size_t dim = 3;
+
+//! @brief The benchmark options for `n` devices (sequential unless `par`).
+template <size_t n, bool par = false, bool sync = false>
+DECLARE_OPTIONS(opt,
+    parallel<par>,
+    synchronised<sync>,
+    program<bench::program<coordination::main>>,
+    exports<coordination::main_t>,
+    round_schedule<bench::round_s>,
+    spawn_schedule<sequence::multiple_n<n, 0>>,
+    tuple_store<
+        speed,              double,
+        area_side,          double,
+        batched,            bool,
+        max_msg,            size_t,
+        tot_msg,            size_t,
+        max_proc,           size_t,
+        tot_proc,           size_t,
+        first_delivery,     times_t,
+        sent_count,         size_t,
+        delivery_count,     size_t,
+        repeat_count,       size_t,
+        log_size,           size_t,
+        distance_bytes,     size_t,
+        tree_bytes,         size_t,
+        process_bytes,      size_t,
+        log_bytes,          size_t,
+        other_bytes,        size_t,
+        attributed_bytes,   attribution::ledger,
+        parent_memory,      delta_memory<double>,
+        below_memory,       delta_memory<coordination::set_t>,
+        walk_cycles,        double,
+        distance_cycles,    double,
+        tree_cycles,        double,
+        spawn_cycles,       double,
+        log_cycles,         double,
+        center_dist,        double,
+        node_color,         color,
+        left_color,         color,
+        right_color,        color,
+        node_size,          double,
+        node_shape,         shape
+    >,
+    bench::store_t,
+    init<
+        x,                  distribution::rect_n<1, 0, 0, 0, bench::side(n), bench::side(n), height>,
+        speed,              distribution::constant_n<double, 1>,
+        area_side,          distribution::constant_n<double, bench::side(n)>
+    >,
+    dimension<dim>,
+    connector<connect::discovery<connect::fixed<comm, 1, dim>>>,
+    message_size<true>
+);
+
+//! @brief The benchmark component for `n` devices.
+template <size_t n>
+using comp_t = component::batch_simulator<opt<n>>;
+
+//! @brief The thread-scaling benchmark component, for a given `synchronised` option.
+template <bool sync>
+using threads_comp_t = component::batch_simulator<opt<bench::threads_size, true, sync>>;
+
+//! @brief The performance regression and autotuning component, for a combination `O` of options.
+template <int O>
+using perf_comp_t = component::batch_simulator<bench::perf_options<O, opt<bench::perf_size, (O & 8) == 8, (O & 16) == 16>>>;
+
+int main(int argc, char** argv) {
+    if (argc > 1 and std::string(argv[1]) == "perf")
+        return bench::perf_main<perf_comp_t>(argc, argv, "message_dispatch");
+    if (argc > 1 and std::string(argv[1]) == "tune")
+        return bench::tune_main<perf_comp_t>(argc, argv, "message_dispatch");
+    if (argc > 1 and std::string(argv[1]) == "threads")
+        return bench::threads_main<threads_comp_t>(argc, argv, "message_dispatch");
+    return bench::main<comp_t>(argc, argv, "message_dispatch");
+}
@@ -0,0 +1,110 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file bench_snapshot.cpp
+ * @brief Benchmark of ground truth lookups from every round, directly on the network or through a snapshot.
+ *
+ * Every round reads the true position of a source changing every 50 time units, and walks
+ * randomly through the batched mobility engine, so that the lookup is a significant part of
+ * the round. Both sequential and thread-scaling benchmarks are run for both lookups.
+ */
+
+#include <memory>
+#include <string>
+
+#include "lib/fcpp.hpp"
+#include "lib/bench.hpp"
+#include "lib/mobility.hpp"
+#include "lib/snapshot.hpp"
+
+namespace fcpp {
+
+//! @brief Communication radius.
+constexpr size_t comm = 100;
+
+//! @brief Height of the deployment area.
+constexpr size_t height = 100;
+
+namespace coordination {
+
+namespace tags {
+    //! @brief True distance of the current node from the source.
+    struct true_distance {};
+}
+
+//! @brief Program reading the position of the source through a snapshot if `snap`, directly otherwise.
+template <bool snap, size_t side>
+struct lookup_main {
+    //! @brief Executes a round of the program.
+    template <typename node_t>
+    void operator()(node_t& node, times_t t) {
+        batch_walk(node, 0, make_vec(0,0,0), make_vec(side,side,height), comm/4, 1);
+        device_t source_id = int(t) / 50;
+        vec<3> source_pos = node.position();
+        if (snap) {
+            snapshot::device_state<3> s = snapshot::selected_state<3>(node, [](times_t t){
+                return device_t(int(t) / 50);
+            });
+            if (s.present) source_pos = s.position_at(t);
+        } else if (node.net.node_count(source_id))
+            source_pos = node.net.node_at(source_id).position(t);
+        node.storage(tags::true_distance{}) = distance(node.position(), source_pos);
+    }
+};
+
+}
+
+}
+
+using namespace fcpp;
+using namespace component::tags;
+using namespace coordination::tags;
+
+//! @brief The benchmark options for `n` devices (with snapshot lookups if `snap`, sequential unless `par`).
+template <size_t n, bool snap, bool par = false, bool sync = false>
+DECLARE_OPTIONS(opt,
+    parallel<par>,
+    synchronised<sync>,
+    program<bench::program<coordination::lookup_main<snap, bench::side(n)>>>,
+    exports<coordination::batch_walk_t<3>>,
+    round_schedule<bench::round_s>,
+    spawn_schedule<sequence::multiple_n<n, 0>>,
+    tuple_store<
+        true_distance,  double,
+        walk_engine,    std::shared_ptr<mobility::engine<3>>,
+        snapshot_board, std::shared_ptr<snapshot::board<snapshot::device_state<3>>>
+    >,
+    bench::store_t,
+    init<
+        x,              distribution::rect_n<1, 0, 0, 0, bench::side(n), bench::side(n), height>,
+        walk_engine,    mobility::shared_engine<3>,
+        snapshot_board, snapshot::shared_board<snapshot::device_state<3>>
+    >,
+    dimension<3>,
+    connector<connect::discovery<connect::fixed<comm, 1, 3>>>,
+    message_size<true>
+);
+
+//! @brief The benchmark component for `n` devices with direct lookups.
+template <size_t n>
+using direct_comp_t = component::batch_simulator<opt<n, false>>;
+
+//! @brief The benchmark component for `n` devices with snapshot lookups.
+template <size_t n>
+using snapshot_comp_t = component::batch_simulator<opt<n, true>>;
+
+//! @brief The thread-scaling benchmark component with direct lookups, for a given `synchronised` option.
+template <bool sync>
+using direct_threads_comp_t = component::batch_simulator<opt<bench::threads_size, false, true, sync>>;
+
+//! @brief The thread-scaling benchmark component with snapshot lookups, for a given `synchronised` option.
+template <bool sync>
+using snapshot_threads_comp_t = component::batch_simulator<opt<bench::threads_size, true, true, sync>>;
+
+int main(int argc, char** argv) {
+    if (argc > 1 and std::string(argv[1]) == "threads")
+        return bench::threads_main<direct_threads_comp_t>(argc, argv, "lookup_direct") +
+               bench::threads_main<snapshot_threads_comp_t>(argc, argv, "lookup_snapshot");
+    return bench::main<direct_comp_t>(argc, argv, "lookup_direct") +
+           bench::main<snapshot_comp_t>(argc, argv, "lookup_snapshot");
+}
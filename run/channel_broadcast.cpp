@@ -2,6 +2,7 @@
 
 #include "lib/fcpp.hpp"
 #include "lib/channel_broadcast.hpp"
+#include "lib/threads.hpp"
 
 using namespace fcpp;
 using namespace component::tags;
@@ -34,11 +35,13 @@ DECLARE_OPTIONS(opt,
         dest_distance,      double,
         distance_c,         color,
         size,               double,
-        node_shape,         shape
+        node_shape,         shape,
+        area_side,          double
     >,
     aggregator_t,
     init<
-        x,                  rectangle_d
+        x,                  rectangle_d,
+        area_side,          distribution::constant_n<double, side>
     >,
     plot_type<plot_t>,
     dimension<dim>,
@@ -53,11 +56,12 @@ int main() {
     std::cout << "/*\n";
     {
         using net_t = component::interactive_simulator<opt>::net;
-        auto init_v = common::make_tagged_tuple<name, epsilon, texture, plotter>(
+        auto init_v = common::make_tagged_tuple<name, epsilon, texture, plotter, threads>(
             "Broadcast through an Elliptic Channel",
             0.1,
             "land.jpg",
-            &p
+            &p,
+            runtime_threads()
         );
         net_t network{init_v};
         network.run();
@@ -0,0 +1,65 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file channel_broadcast_record.cpp
+ * @brief Records an execution of the channel broadcast case study, to be viewed with `replay`.
+ *
+ * Usage: `channel_broadcast_record [file [end]]` (defaults to `channel_broadcast.rec` and 300).
+ * The simulation runs at full speed under the batch simulator, with the options of `channel_broadcast`.
+ */
+
+#include "lib/fcpp.hpp"
+#include "lib/channel_broadcast.hpp"
+#include "lib/recording.hpp"
+#include "lib/threads.hpp"
+
+using namespace fcpp;
+using namespace component::tags;
+using namespace coordination::tags;
+
+constexpr size_t dim = 3;
+
+//! @brief End of the simulation (read from the initialisation values).
+struct end_time {};
+
+using round_s = sequence::periodic<
+    distribution::interval_n<times_t, 0, 1>,
+    distribution::weibull_n<times_t, 10, 1, 10>,
+    distribution::constant_i<times_t, end_time>
+>;
+
+using rectangle_d = distribution::rect_n<1, 0, 0, 0, side, side, height>;
+
+DECLARE_OPTIONS(opt,
+    parallel<true>,
+    synchronised<false>,
+    program<recording::program<coordination::main, size, node_shape, distance_c>>,
+    exports<coordination::main_t>,
+    round_schedule<round_s>,
+    spawn_schedule<sequence::multiple_n<devices, 0>>,
+    tuple_store<
+        in_channel,         bool,
+        source_distance,    double,
+        dest_distance,      double,
+        distance_c,         color,
+        size,               double,
+        node_shape,         shape,
+        area_side,          double
+    >,
+    init<
+        x,                  rectangle_d,
+        area_side,          distribution::constant_n<double, side>
+    >,
+    dimension<dim>,
+    connector<connect::fixed<comm, 1, dim>>
+);
+
+int main(int argc, char** argv) {
+    recording::writer w(argc > 1 ? argv[1] : "channel_broadcast.rec", 1);
+    times_t end = argc > 2 ? std::strtod(argv[2], nullptr) : 300;
+    using net_t = component::batch_simulator<opt>::net;
+    auto init_v = common::make_tagged_tuple<end_time, threads>(end, runtime_threads());
+    net_t network{init_v};
+    network.run();
+    return 0;
+}
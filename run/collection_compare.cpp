@@ -2,12 +2,13 @@
 
 #include "lib/fcpp.hpp"
 #include "lib/collection_compare.hpp"
+#include "lib/threads.hpp"
 
 using namespace fcpp;
 using namespace component::tags;
 using namespace coordination::tags;
 
-constexpr size_t algo       = 1;
+constexpr int    algo       = -1; // distance algorithm (0: abf, 1: bis, 2: flex), all side by side if negative
 constexpr size_t device_num = 1000;
 constexpr size_t end_time   = 500;
 constexpr size_t maxX       = 2000;
@@ -28,42 +29,41 @@ using rectangle_d = distribution::rect_n<1, 0, 0, maxX, maxY>;
 DECLARE_OPTIONS(opt,
     parallel<true>,
     synchronised<false>,
-    program<coordination::main>,
-    exports<coordination::main_t>,
+    program<std::conditional_t<(algo < 0), coordination::main_all, coordination::main>>,
+    exports<std::conditional_t<(algo < 0), coordination::compare_all_t, coordination::main_t>>,
     round_schedule<round_s>,
     log_schedule<log_s>,
     spawn_schedule<spawn_s>,
     tuple_store<
-        algorithm,  int,
-        spc_sum,    double,
-        mpc_sum,    double,
-        wmpc_sum,   double,
-        ideal_sum,  double,
-        spc_max,    double,
-        mpc_max,    double,
-        wmpc_max,   double,
-        ideal_max,  double
+        algorithm,      int,
+        ideal_sum,      double,
+        ideal_max,      double,
+        area_length,    double,
+        snapshot_board, std::shared_ptr<snapshot::board<snapshot::device_state<2>>>
     >,
+    option::algo_store_t<-1>,
+    option::algo_store_t<0>,
+    option::algo_store_t<1>,
+    option::algo_store_t<2>,
     aggregators<
-        spc_sum,    aggregator::sum<double>,
-        mpc_sum,    aggregator::sum<double>,
-        wmpc_sum,   aggregator::sum<double>,
         ideal_sum,  aggregator::sum<double>,
-        spc_max,    aggregator::max<double>,
-        mpc_max,    aggregator::max<double>,
-        wmpc_max,   aggregator::max<double>,
         ideal_max,  aggregator::max<double>
     >,
+    std::conditional_t<(algo < 0), option::algo_aggregator_t<0>, option::algo_aggregator_t<-1>>,
+    std::conditional_t<(algo < 0), option::algo_aggregator_t<1>, aggregators<>>,
+    std::conditional_t<(algo < 0), option::algo_aggregator_t<2>, aggregators<>>,
     init<
-        x,          rectangle_d,
-        algorithm,  distribution::constant_n<int, algo>
+        x,              rectangle_d,
+        area_length,    distribution::constant_n<double, maxX>,
+        algorithm,      distribution::constant_n<int, algo>,
+        snapshot_board, snapshot::shared_board<snapshot::device_state<2>>
     >,
     connector<connect::fixed<100>>
 );
 
 int main() {
     using net_t = component::batch_simulator<opt>::net;
-    auto init_v = common::make_tagged_tuple<epsilon>(0.1);
+    auto init_v = common::make_tagged_tuple<epsilon, threads>(0.1, runtime_threads());
     net_t network{init_v};
     network.run();
     return 0;
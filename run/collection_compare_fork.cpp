@@ -0,0 +1,124 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file collection_compare_fork.cpp
+ * @brief Compares how distance algorithms react to the source switch, forking from a common warm state.
+ *
+ * The network is simulated once with every distance algorithm side by side until the source
+ * switch, and then forked into a branch for every choice of the new source (which does not affect
+ * the state before the switch). Each branch logs into its own file, starting with the header and
+ * the rows of the common warm-up.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+
+#include "lib/fcpp.hpp"
+#include "lib/checkpoint.hpp"
+#include "lib/collection_compare.hpp"
+
+using namespace fcpp;
+using namespace component::tags;
+using namespace coordination::tags;
+
+constexpr size_t device_num = 1000;
+constexpr size_t fork_time  = 250;
+constexpr size_t end_time   = 500;
+constexpr size_t maxX       = 2000;
+constexpr size_t maxY       = 200;
+
+using round_s = sequence::periodic<
+    distribution::interval_n<times_t, 0, 1>,
+    distribution::weibull_n<times_t, 100, 25, 100>,
+    distribution::constant_n<times_t, end_time+2>
+>;
+
+using log_s = sequence::periodic_n<1, 0, 10, end_time>;
+
+using spawn_s = sequence::multiple_n<device_num, 0>;
+
+using rectangle_d = distribution::rect_n<1, 0, 0, maxX, maxY>;
+
+//! @brief The devices becoming the source at the switch, one per branch.
+constexpr device_t switch_ids[] = {1, device_num/2, device_num-1};
+
+namespace fcpp {
+namespace coordination {
+namespace tags {
+    //! @brief The device becoming the source at the switch.
+    struct switch_id {};
+}
+
+//! @brief Main program running every distance algorithm side by side, switching source to the stored device.
+struct main_fork {
+    //! @brief Executes a round of the program.
+    template <typename node_t>
+    void operator()(node_t& node, times_t) {
+        compare_all(node, 0, node.storage(tags::switch_id{}));
+    }
+};
+}
+}
+
+// forking requires no worker thread to be alive: the network must be sequential
+DECLARE_OPTIONS(opt,
+    parallel<false>,
+    synchronised<false>,
+    program<coordination::main_fork>,
+    exports<coordination::compare_all_t>,
+    round_schedule<round_s>,
+    log_schedule<log_s>,
+    spawn_schedule<spawn_s>,
+    tuple_store<
+        switch_id,      device_t,
+        ideal_sum,      double,
+        ideal_max,      double,
+        area_length,    double,
+        snapshot_board, std::shared_ptr<snapshot::board<snapshot::device_state<2>>>
+    >,
+    option::algo_store_t<0>,
+    option::algo_store_t<1>,
+    option::algo_store_t<2>,
+    aggregators<
+        ideal_sum,  aggregator::sum<double>,
+        ideal_max,  aggregator::max<double>
+    >,
+    option::algo_aggregator_t<0>,
+    option::algo_aggregator_t<1>,
+    option::algo_aggregator_t<2>,
+    init<
+        x,              rectangle_d,
+        area_length,    distribution::constant_n<double, maxX>,
+        switch_id,      distribution::constant_n<device_t, 1>,
+        snapshot_board, snapshot::shared_board<snapshot::device_state<2>>
+    >,
+    connector<connect::fixed<100>>
+);
+
+int main() {
+    using net_t = component::batch_simulator<opt>::net;
+    // the header and the rows of the warm-up are logged into a common file
+    std::string common_file = "output/collection_compare_fork-warmup.txt";
+    std::freopen(common_file.c_str(), "w", stdout);
+    auto init_v = common::make_tagged_tuple<epsilon>(0.1);
+    net_t network{init_v};
+    // common warm-up until the source switch
+    checkpoint::run_until(network, fork_time);
+    // one branch per new source, logging into its own file after a copy of the warm-up
+    size_t failed = checkpoint::branches(std::size(switch_ids), [&](size_t b){
+        std::string file = "output/collection_compare_fork-" + std::to_string(switch_ids[b]) + ".txt";
+        if (std::freopen(file.c_str(), "w", stdout) == nullptr) std::_Exit(1);
+        if (std::FILE* f = std::fopen(common_file.c_str(), "r")) {
+            char buf[1 << 16];
+            for (size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0; ) std::fwrite(buf, 1, n, stdout);
+            std::fclose(f);
+        }
+        std::printf("# branch: switch_id = %d\n", int(switch_ids[b]));
+        for (device_t i = 0; i < device_num; ++i)
+            if (network.node_count(i)) network.node_at(i).storage(switch_id{}) = switch_ids[b];
+        network.run();
+    });
+    return failed > 0;
+}
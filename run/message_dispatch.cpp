@@ -2,6 +2,7 @@
 
 #include "lib/fcpp.hpp"
 #include "lib/message_dispatch.hpp"
+#include "lib/threads.hpp"
 
 using namespace fcpp;
 using namespace component::tags;
@@ -27,6 +28,8 @@ using round_s = sequence::periodic<
 
 using rectangle_d = distribution::rect_n<1, 0, 0, 0, side, side, height>;
 
+using cycles_aggregator_t = aggregator::combine<aggregator::mean<double>, aggregator::max<double>>;
+
 using aggregator_t = aggregators<
     max_msg,        aggregator::max<size_t>,
     tot_msg,        aggregator::sum<size_t>,
@@ -35,7 +38,21 @@ using aggregator_t = aggregators<
     first_delivery, aggregator::sum<double>,
     sent_count,     aggregator::sum<size_t>,
     delivery_count, aggregator::sum<size_t>,
-    repeat_count,   aggregator::sum<size_t>
+    repeat_count,   aggregator::sum<size_t>,
+    log_size,       aggregator::combine<
+                        aggregator::max<size_t>,
+                        aggregator::sum<size_t>
+                    >,
+    distance_bytes, aggregator::sum<size_t>,
+    tree_bytes,     aggregator::sum<size_t>,
+    process_bytes,  aggregator::sum<size_t>,
+    log_bytes,      aggregator::sum<size_t>,
+    other_bytes,    aggregator::sum<size_t>,
+    walk_cycles,    cycles_aggregator_t,
+    distance_cycles,cycles_aggregator_t,
+    tree_cycles,    cycles_aggregator_t,
+    spawn_cycles,   cycles_aggregator_t,
+    log_cycles,     cycles_aggregator_t
 >;
 
 template <typename... Ts>
@@ -46,7 +63,9 @@ using maxs_t = plot::filter<plot::time, filter::below<100>, plot::split<plot::ti
 using tots_t = plot::split<plot::time, rows_t<avg_msg_exchanged, avg_active_proc>>;
 using counts_t = plot::split<plot::time, lines_t<sent_count, delivery_count, repeat_count>>;
 using delay_t = plot::split<plot::time, rows_t<avg_first_delivery>>;
-using plot_t = plot::join<maxs_t, tots_t, counts_t, delay_t>;
+using bytes_t = plot::split<plot::time, lines_t<tot_msg, distance_bytes, tree_bytes, process_bytes, log_bytes, other_bytes>>;
+using cycles_t = plot::split<plot::time, lines_t<walk_cycles, distance_cycles, tree_cycles, spawn_cycles, log_cycles>>;
+using plot_t = plot::join<maxs_t, tots_t, counts_t, delay_t, bytes_t, cycles_t>;
 
 DECLARE_OPTIONS(opt,
     parallel<true>,
@@ -58,6 +77,8 @@ DECLARE_OPTIONS(opt,
     spawn_schedule<sequence::multiple_n<devices, 0>>,
     tuple_store<
         speed,              double,
+        area_side,          double,
+        batched,            bool,
         max_msg,            size_t,
         tot_msg,            size_t,
         max_proc,           size_t,
@@ -66,6 +87,20 @@ DECLARE_OPTIONS(opt,
         sent_count,         size_t,
         delivery_count,     size_t,
         repeat_count,       size_t,
+        log_size,           size_t,
+        distance_bytes,     size_t,
+        tree_bytes,         size_t,
+        process_bytes,      size_t,
+        log_bytes,          size_t,
+        other_bytes,        size_t,
+        attributed_bytes,   attribution::ledger,
+        parent_memory,      delta_memory<double>,
+        below_memory,       delta_memory<coordination::set_t>,
+        walk_cycles,        double,
+        distance_cycles,    double,
+        tree_cycles,        double,
+        spawn_cycles,       double,
+        log_cycles,         double,
         center_dist,        double,
         node_color,         color,
         left_color,         color,
@@ -81,7 +116,9 @@ DECLARE_OPTIONS(opt,
     >,
     init<
         x,                  rectangle_d,
-        speed,              distribution::constant_n<double, 1>
+        speed,              distribution::constant_n<double, 1>,
+        area_side,          distribution::constant_n<double, side>,
+        batched,            distribution::constant_i<bool, batched>
     >,
     plot_type<plot_t>,
     dimension<dim>,
@@ -92,20 +129,25 @@ DECLARE_OPTIONS(opt,
     color_tag<node_color, left_color, right_color>
 );
 
-int main() {
+int main(int argc, char** argv) {
+    bool batched_mode = argc > 1 and std::string(argv[1]) == "batched";
     plot_t p;
     std::cout << "/*\n";
     {
         using net_t = component::interactive_simulator<opt>::net;
-        auto init_v = common::make_tagged_tuple<name, epsilon, plotter>(
+        auto init_v = common::make_tagged_tuple<name, epsilon, plotter, batched, threads>(
             "Dispatch of Peer-to-peer Messages",
             0.1,
-            &p
+            &p,
+            batched_mode,
+            runtime_threads()
         );
         net_t network{init_v};
         network.run();
     }
     std::cout << "*/\n";
     std::cout << plot::file("message_dispatch", p.build());
+    profile::report(std::cerr);
+    attribution::report(std::cerr);
     return 0;
 }
@@ -0,0 +1,184 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file replay.cpp
+ * @brief Replays a recording in the graphical user interface, at any speed and from any time.
+ *
+ * Usage: `replay file [speed [start]]`. The recording (produced by `channel_broadcast_record` or
+ * `spreading_collection_record`) is played from its time `start` (default 0), advancing `speed`
+ * recorded time units every simulated time unit (default 1). Nodes are moved to their recorded
+ * positions, and take their recorded size, shape and colors, without re-simulating.
+ *
+ * While playing, lines typed on the standard input control the playback: `seek t` jumps to the
+ * recorded time `t`, and `speed s` changes the speed from the current recorded time.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "lib/fcpp.hpp"
+#include "lib/recording.hpp"
+
+namespace fcpp {
+
+//! @brief Time between replayed rounds.
+constexpr times_t replay_step = 0.1;
+
+//! @brief Playback settings.
+struct playback {
+    //! @brief The recording played.
+    recording::reader* trace = nullptr;
+    //! @brief Recorded time units played every simulated time unit.
+    times_t speed = 1;
+    //! @brief Recorded time played at simulated time zero.
+    times_t start = 0;
+    //! @brief The last simulated time played.
+    times_t now = 0;
+    //! @brief Guards the settings, changed by commands while playing.
+    std::mutex mutex;
+
+    //! @brief The playback settings of the process.
+    static playback& get() {
+        static playback p;
+        return p;
+    }
+
+    //! @brief The recorded time played at a simulated time.
+    times_t recorded(times_t t) {
+        std::lock_guard<std::mutex> l(mutex);
+        now = std::max(now, t);
+        return start + speed * t;
+    }
+
+    //! @brief Executes a command (`seek t` or `speed s`), returning whether it was understood.
+    bool command(std::string const& line) {
+        std::istringstream ss(line);
+        std::string c;
+        times_t x;
+        if (not (ss >> c >> x)) return false;
+        std::lock_guard<std::mutex> l(mutex);
+        if (c == "seek") {
+            x = std::min(std::max(x, trace->start()), trace->end());
+            start = x - speed * now;
+            return true;
+        }
+        if (c == "speed") {
+            start += (speed - x) * now;
+            speed = x;
+            return true;
+        }
+        return false;
+    }
+};
+
+namespace coordination {
+
+namespace tags {
+    //! @brief Number of nodes in the recording.
+    struct replay_devices {};
+
+    //! @brief First color of the current node.
+    struct node_color {};
+
+    //! @brief Second color of the current node.
+    struct left_color {};
+
+    //! @brief Third color of the current node.
+    struct right_color {};
+
+    //! @brief Size of the current node.
+    struct node_size {};
+
+    //! @brief Shape of the current node.
+    struct node_shape {};
+}
+
+//! @brief Main function, moving the node towards its recorded position at the next round.
+MAIN() {
+    using namespace tags;
+    playback& p = playback::get();
+    std::vector<recording::node_state> const& v = p.trace->at(p.recorded(node.current_time() + replay_step));
+    if (node.uid >= v.size() or not v[node.uid].present) {
+        node.velocity() = make_vec(0, 0, 0);
+        node.storage(node_size{}) = 0;
+        return;
+    }
+    recording::node_state const& s = v[node.uid];
+    node.velocity() = (make_vec(s.position[0], s.position[1], s.position[2]) - node.position()) / replay_step;
+    size_t k = std::max<size_t>(p.trace->colors(), 1);
+    node.storage(node_size{}) = s.size;
+    node.storage(node_shape{}) = shape(s.shape);
+    node.storage(node_color{}) = recording::unpack(s.colors[0]);
+    node.storage(left_color{}) = recording::unpack(s.colors[std::min<size_t>(1, k-1)]);
+    node.storage(right_color{}) = recording::unpack(s.colors[std::min<size_t>(2, k-1)]);
+}
+//! @brief Exports for the main function.
+FUN_EXPORT main_t = common::export_list<>;
+
+}
+
+namespace option {
+
+using namespace component::tags;
+using namespace coordination::tags;
+
+DECLARE_OPTIONS(list,
+    parallel<false>,
+    synchronised<true>,
+    program<coordination::main>,
+    exports<coordination::main_t>,
+    round_schedule<sequence::periodic_n<10, 0, 1>>,
+    spawn_schedule<sequence::multiple<
+        distribution::constant_i<size_t, replay_devices>,
+        distribution::constant_n<times_t, 0>
+    >>,
+    tuple_store<
+        node_color,     color,
+        left_color,     color,
+        right_color,    color,
+        node_size,      double,
+        node_shape,     shape
+    >,
+    dimension<3>,
+    connector<connect::fixed<0, 1, 3>>,
+    shape_tag<node_shape>,
+    size_tag<node_size>,
+    color_tag<node_color, left_color, right_color>
+);
+
+}
+
+}
+
+int main(int argc, char** argv) {
+    using namespace fcpp;
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " file [speed [start]]" << std::endl;
+        return 1;
+    }
+    recording::reader trace(argv[1]);
+    if (not trace.good()) {
+        std::cerr << "cannot read recording " << argv[1] << std::endl;
+        return 1;
+    }
+    playback& p = playback::get();
+    p.trace = &trace;
+    p.speed = argc > 2 ? std::strtod(argv[2], nullptr) : 1;
+    p.start = argc > 3 ? std::strtod(argv[3], nullptr) : 0;
+    std::thread([&p](){
+        for (std::string line; std::getline(std::cin, line); )
+            if (not p.command(line)) std::cerr << "unknown command (use \"seek t\" or \"speed s\"): " << line << std::endl;
+    }).detach();
+    using net_t = component::interactive_simulator<option::list>::net;
+    auto init_v = common::make_tagged_tuple<option::name, option::replay_devices>(
+        "Replay of " + std::string(argv[1]),
+        trace.devices()
+    );
+    net_t network{init_v};
+    network.run();
+    return 0;
+}
@@ -5,25 +5,56 @@
  * @brief Runs multiple executions of the spreading collection case study non-interactively from the command line, producing overall plots.
  */
 
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
 #include "lib/spreading_collection.hpp"
+#include "lib/columnar.hpp"
+#include "lib/result_cache.hpp"
+#include "lib/sweep.hpp"
 
 using namespace fcpp;
 
-int main() {
+//! @brief Usage: `spreading_collection_batch [threads [text]]` (threads default to the available hardware concurrency).
+int main(int argc, char** argv) {
+    //! @brief The number of threads running simulations.
+    size_t threads = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : sweep::default_threads();
+    threads = std::max<size_t>(threads, 1);
+    //! @brief Whether the logged rows should also be exported as text.
+    bool text = argc > 2 and std::string(argv[2]) == "text";
     //! @brief Construct the plotter object.
     option::plot_t p;
-    //! @brief The component type (batch simulator with given options).
-    using comp_t = component::batch_simulator<option::list>;
+    //! @brief The columnar binary log of the aggregator rows (with the parameters of every run).
+    using log_t = columnar::log_file<option::plot_t, option::seed, option::speed>;
+    log_t log("output/spreading_collection_batch");
+    //! @brief The online reduction of the aggregator rows (by time and speed) into the plot.
+    using reducer_t = sweep::reducer<option::plot_t, option::row_aggregator_t, plot::time, option::speed>;
+    reducer_t r;
+    //! @brief The plotter receiving the rows of every simulation (cached or not), logging them into both.
+    using sink_t = sweep::tee<reducer_t, log_t>;
+    sink_t sink{&r, &log};
+    //! @brief The simulation options (logging rows into the result cache).
+    using options_t = option::plotted_list<cache::writer<sink_t>>;
     //! @brief The list of initialisation values to be used for simulations.
     auto init_list = batch::make_tagged_tuple_sequence(
         batch::arithmetic<option::seed>(0, 9, 1),                   // 10 different random seeds
         batch::arithmetic<option::speed>(size_t(0), comm/2, comm/20), // 11 different speeds
-        // generate output file name for the run
-        batch::stringify<option::output>("output/spreading_collection_batch", "txt"),
-        batch::constant<option::plotter>(&p)                        // reference to the plotter object
+        // rows are logged in binary form, disable the textual output of every run
+        batch::constant<option::output>(&columnar::null_stream())
     );
-    //! @brief Runs the given simulations.
-    batch::run(comp_t{}, init_list);
+    //! @brief Runs the simulations not in the result cache in parallel, then feeds the rows of all of them into the sink.
+    size_t n = cache::run<options_t>(init_list, sink, "output/cache", threads);
+    std::cerr << "simulated " << n << " of " << init_list.size() << " runs (the others were cached)" << std::endl;
+    //! @brief Feeds the reduced rows into the plotter.
+    r.emit(p);
+    //! @brief Optionally exports the logged rows as text.
+    if (text) {
+        std::ofstream f("output/spreading_collection_batch.txt");
+        log.export_text(f);
+    }
     //! @brief Builds the resulting plots.
     std::cout << plot::file("batch", p.build());
     return 0;
@@ -0,0 +1,62 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file spreading_collection_handover.cpp
+ * @brief Compares the convergence of the spreading collection case study after source handovers, with and without warm-up.
+ *
+ * For every speed, the case study is run with the same seeds with `main` and with `warm_main`.
+ * The error of `calc_distance` with respect to `true_distance` is averaged over devices in every
+ * time unit. After every handover, the convergence time is the time until that error first falls
+ * within `converged_error` (or the whole window if it never does).
+ */
+
+#include <iostream>
+#include <vector>
+
+#include "lib/spreading_collection_compare.hpp"
+
+namespace fcpp {
+
+//! @brief Time between source handovers.
+constexpr size_t handover_step = source_period;
+
+//! @brief Mean distance error within which a gradient is considered converged.
+constexpr double converged_error = comm / 5;
+
+//! @brief Time to converge after a handover, averaged over handovers.
+double convergence(compare::series const& s) {
+    double r = 0;
+    size_t handovers = 0;
+    for (size_t h = handover_step; h < end_time; h += handover_step, ++handovers) {
+        size_t t = h;
+        while (t < h + handover_step and t < end_time and s.error[t] > converged_error) ++t;
+        r += t - h;
+    }
+    return r / handovers;
+}
+
+}
+
+using namespace fcpp;
+
+
+//! @brief Usage: `spreading_collection_handover [seeds]` (seeds default to 3).
+int main(int argc, char** argv) {
+    using base_t = option::tracked_list<coordination::main>;
+    using warm_t = option::tracked_list<coordination::warm_main>;
+    return compare::main<base_t, warm_t>(argc, argv, [](size_t speed, std::vector<compare::series> const& base, std::vector<compare::series> const& warm){
+        double conv = 0, warm_conv = 0, error = 0, warm_error = 0;
+        for (size_t i = 0; i < base.size(); ++i) {
+            conv += convergence(base[i]) / base.size();
+            warm_conv += convergence(warm[i]) / warm.size();
+            error += base[i].mean_error() / base.size();
+            warm_error += warm[i].mean_error() / warm.size();
+        }
+        std::cout << "{\"speed\": " << speed
+                  << ", \"convergence\": " << conv
+                  << ", \"warm_convergence\": " << warm_conv
+                  << ", \"error\": " << error
+                  << ", \"warm_error\": " << warm_error
+                  << "}" << std::endl;
+    });
+}
@@ -0,0 +1,41 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file spreading_collection_quiescent.cpp
+ * @brief Compares the spreading collection case study with and without quiescent rounds.
+ *
+ * For every speed, the case study is run with the same seeds with `main` and with
+ * `quiescent_main`, reporting the rounds performed and the distance error of the values
+ * held by devices, averaged over time and devices.
+ */
+
+#include <iostream>
+#include <vector>
+
+#include "lib/spreading_collection_compare.hpp"
+
+using namespace fcpp;
+
+
+//! @brief Usage: `spreading_collection_quiescent [seeds]` (seeds default to 3).
+int main(int argc, char** argv) {
+    using base_t  = option::tracked_list<coordination::main>;
+    using quiet_t = option::tracked_list<coordination::quiescent_main, option::quiescent_retain_t>;
+    return compare::main<base_t, quiet_t>(argc, argv, [](size_t speed, std::vector<compare::series> const& base, std::vector<compare::series> const& quiet){
+        double rounds = 0, quiet_rounds = 0, error = 0, quiet_error = 0;
+        for (size_t i = 0; i < base.size(); ++i) {
+            rounds += base[i].rounds.back();
+            quiet_rounds += quiet[i].rounds.back();
+            error += base[i].mean_error() / base.size();
+            quiet_error += quiet[i].mean_error() / quiet.size();
+        }
+        std::cout << "{\"speed\": " << speed
+                  << ", \"rounds\": " << rounds
+                  << ", \"quiescent_rounds\": " << quiet_rounds
+                  << ", \"rounds_saved\": " << 1 - quiet_rounds / rounds
+                  << ", \"error\": " << error
+                  << ", \"quiescent_error\": " << quiet_error
+                  << ", \"error_change\": " << quiet_error - error
+                  << "}" << std::endl;
+    });
+}
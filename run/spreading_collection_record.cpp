@@ -0,0 +1,32 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file spreading_collection_record.cpp
+ * @brief Records a single execution of the spreading collection case study, to be viewed with `replay`.
+ *
+ * Usage: `spreading_collection_record [file]` (defaults to `spreading_collection.rec`).
+ */
+
+#include "lib/spreading_collection.hpp"
+#include "lib/recording.hpp"
+
+using namespace fcpp;
+
+//! @brief The recorded program.
+using program_t = recording::program<coordination::main, option::node_size, option::node_shape, option::distance_c, option::source_diameter_c, option::diameter_c>;
+
+int main(int argc, char** argv) {
+    //! @brief The recording file, written while the simulation runs.
+    recording::writer w(argc > 1 ? argv[1] : "spreading_collection.rec", 3);
+    //! @brief The plotter object (unused).
+    option::plot_t p;
+    //! @brief The network object type (batch simulator with given options).
+    using net_t = component::batch_simulator<option::plotted_list<option::plot_t, program_t>>::net;
+    //! @brief The initialisation values (node movement speed, plotter).
+    auto init_v = common::make_tagged_tuple<option::speed, option::plotter>(comm/4, &p);
+    //! @brief Construct the network object.
+    net_t network{init_v};
+    //! @brief Run the simulation until exit.
+    network.run();
+    return 0;
+}
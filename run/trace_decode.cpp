@@ -0,0 +1,66 @@
+// Copyright © 2022 Giorgio Audrito. All Rights Reserved.
+
+/**
+ * @file trace_decode.cpp
+ * @brief Converts a binary trace file (produced with `FCPP_TRACE=1`) into text.
+ *
+ * Usage: `trace_decode [file]` (defaults to `trace.bin`), printing one line per record.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lib/trace.hpp"
+
+using namespace fcpp;
+
+int main(int argc, char** argv) {
+    char const* path = argc > 1 ? argv[1] : "trace.bin";
+    FILE* f = fopen(path, "rb");
+    if (not f) {
+        std::cerr << "cannot open " << path << std::endl;
+        return 1;
+    }
+    char m[sizeof(trace::magic)];
+    if (fread(m, sizeof(m), 1, f) != 1 or memcmp(m, trace::magic, sizeof(m)) != 0) {
+        std::cerr << path << " is not a trace file" << std::endl;
+        return 1;
+    }
+    // first pass: skip the records to read the name table
+    long start = ftell(f);
+    trace::record r{};
+    bool ended = false;
+    while (not ended and fread(&r, sizeof(r), 1, f) == 1) ended = r.type == trace::kind::end;
+    auto truncated = [&](){
+        std::cerr << path << " is truncated" << std::endl;
+        fclose(f);
+        return 1;
+    };
+    if (not ended) return truncated();
+    size_t dropped = r.value;
+    uint32_t n = 0;
+    if (fread(&n, sizeof(uint32_t), 1, f) != 1) return truncated();
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t l = 0;
+        if (fread(&l, sizeof(uint32_t), 1, f) != 1) return truncated();
+        std::string s(l, '\0');
+        if (l > 0 and fread(&s[0], 1, l, f) != l) return truncated();
+        names.push_back(std::move(s));
+    }
+    // second pass: print the records
+    fseek(f, start, SEEK_SET);
+    while (fread(&r, sizeof(r), 1, f) == 1 and r.type != trace::kind::end) {
+        std::cout << r.time << " " << r.uid << " " << (r.key < names.size() ? names[r.key] : "?");
+        if (r.type == trace::kind::field) std::cout << "[" << r.nbr << "]";
+        if (r.type == trace::kind::other) std::cout << "[*]";
+        if (r.type != trace::kind::mark) std::cout << " = " << r.value;
+        std::cout << "\n";
+    }
+    fclose(f);
+    if (dropped) std::cerr << dropped << " records were dropped" << std::endl;
+    return 0;
+}
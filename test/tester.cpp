@@ -1,5 +1,22 @@
 // Copyright © 2020 Giorgio Audrito. All Rights Reserved.
 
+// attribution of exported bytes is tested whether or not the project enables it
+#ifndef FCPP_EXPORT_SIZE
+#define FCPP_EXPORT_SIZE 1
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "lib/fcpp.hpp"
@@ -7,6 +24,19 @@
 #include "test/test_net.hpp"
 
 #include "lib/collection_compare.hpp"
+#include "lib/columnar.hpp"
+#include "lib/delta_export.hpp"
+#include "lib/device_set.hpp"
+#include "lib/dispatch.hpp"
+#include "lib/export_size.hpp"
+#include "lib/handover.hpp"
+#include "lib/multi_gradient.hpp"
+#include "lib/obstacle_index.hpp"
+#include "lib/quiescence.hpp"
+#include "lib/recording.hpp"
+#include "lib/result_cache.hpp"
+#include "lib/snapshot.hpp"
+#include "lib/windowed_map.hpp"
 
 using namespace fcpp;
 using namespace coordination::tags;
@@ -23,15 +53,17 @@ DECLARE_OPTIONS(options,
         tuple<double,device_t>, tuple<double,int>, tuple<double,double>
     >,
     tuple_store<
-        algorithm,  int,
-        spc_sum,    double,
-        mpc_sum,    double,
-        wmpc_sum,   double,
-        ideal_sum,  double,
-        spc_max,    double,
-        mpc_max,    double,
-        wmpc_max,   double,
-        ideal_max,  double
+        algorithm,      int,
+        spc_sum,        double,
+        mpc_sum,        double,
+        wmpc_sum,       double,
+        ideal_sum,      double,
+        spc_max,        double,
+        mpc_max,        double,
+        wmpc_max,       double,
+        ideal_max,      double,
+        area_length,    double,
+        snapshot_board, std::shared_ptr<snapshot::board<snapshot::device_state<2>>>
     >,
     export_pointer<(O & 1) == 1>,
     export_split<(O & 2) == 2>,
@@ -58,3 +90,937 @@ MULTI_TEST(CollectionCompareTest, ShortLine, O, 5) {
     EXPECT_ROUND(n, {1, 1, 1});
     EXPECT_ROUND(n, {1, 1, 1});
 }
+
+
+namespace coordination {
+    namespace tags {
+        //! @brief Parameter of a run in a columnar log.
+        struct col_param {};
+
+        //! @brief Value logged in a columnar log.
+        struct col_value {};
+    }
+}
+
+//! @brief Plotter collecting the rows of a columnar log.
+struct col_sink {
+    //! @brief The parameters and values of the rows received.
+    std::vector<std::pair<double, double>> rows;
+
+    //! @brief Receives a row.
+    template <typename R>
+    col_sink& operator<<(R const& row) {
+        rows.emplace_back(common::get<col_param>(row), common::get<col_value>(row));
+        return *this;
+    }
+};
+
+TEST(ColumnarTest, RoundTrip) {
+    columnar::log_file<col_sink, col_param> log("columnar_test");
+    for (double p : {1.0, 2.0}) for (double v : {10.0, 11.0})
+        log << common::make_tagged_tuple<col_param, col_value>(p, p * v);
+    col_sink s;
+    log.replay(s);
+    std::vector<std::pair<double, double>> rows{{1, 10}, {1, 11}, {2, 20}, {2, 22}};
+    EXPECT_EQ(rows, s.rows);
+    std::stringstream text;
+    log.export_text(text);
+    std::string run = "##########################################################\n";
+    std::string cols = "#\n# The columns have the following meaning:\n# col_value\n";
+    EXPECT_EQ(run + "# col_param = 1\n" + run + cols + "10\n11\n\n" + run + "# col_param = 2\n" + run + cols + "20\n22\n", text.str());
+    // appending to the log extends the columns
+    columnar::log_file<col_sink, col_param> more("columnar_test", true);
+    more << common::make_tagged_tuple<col_param, col_value>(3.0, 30.0);
+    col_sink t;
+    more.replay(t);
+    rows.emplace_back(3, 30);
+    EXPECT_EQ(rows, t.rows);
+    // logs in missing directories fail on construction
+    EXPECT_THROW(columnar::log_file<col_sink> bad("missing_directory/columnar_test"), std::runtime_error);
+    for (char const* f : {"columnar_test.head", "columnar_test.0.col", "columnar_test.1.col"})
+        std::remove(f);
+}
+
+
+namespace coordination {
+    namespace tags {
+        //! @brief Whether delta_nbr agreed with nbr in the last round.
+        struct delta_agree {};
+
+        //! @brief State of delta_nbr.
+        struct delta_state {};
+
+        //! @brief Number of rounds after time 5 in which delta_nbr disagreed with nbr.
+        struct delta_wrong {};
+
+        //! @brief Total message size.
+        struct delta_bytes {};
+
+        //! @brief State of delta_nbr gossiping the maximum identifier.
+        struct delta_gossip {};
+
+        //! @brief Markers which delta_nbr could not decode up to the last round.
+        struct delta_missed {};
+
+        //! @brief Maximum identifier gossiped through delta_nbr.
+        struct delta_max {};
+
+        //! @brief Maximum identifier gossiped through nbr.
+        struct nbr_max {};
+    }
+
+    //! @brief Compares delta_nbr with nbr on a value changing every other round.
+    FUN void delta_check(ARGS) { CODE
+        int r = old(CALL, 0, [](int r){
+            return r + 1;
+        });
+        double v = node.uid + r / 2;
+        field<double> d = delta_nbr(CALL, tags::delta_state{}, 0.0, v);
+        field<double> n = nbr(CALL, 0.0, v);
+        node.storage(tags::delta_agree{}) = fold_hood(CALL, [](bool x, bool y){
+            return x and y;
+        }, map_hood([](double x, double y){
+            return x == y;
+        }, d, n), true);
+    }
+    //! @brief Exports for the delta_check function.
+    FUN_EXPORT delta_check_t = common::export_list<int, double, delta_nbr_t<double>>;
+
+    //! @brief Program running delta_check.
+    struct delta_main {
+        template <typename node_t>
+        void operator()(node_t& node, times_t) {
+            delta_check(node, 0);
+        }
+    };
+
+    //! @brief Shares a large value changing every 20 time units, with nbr (M = 0), delta_nbr (M = 1), or both comparing them (M = 2).
+    template <int M, typename node_t>
+    void delta_async(node_t& node, trace_t call_point) { CODE
+        std::vector<double> v(64, node.uid + int(node.current_time() / 20));
+        field<std::vector<double>> n{std::vector<double>{}};
+        field<std::vector<double>> d{std::vector<double>{}};
+        if (M != 1) n = nbr(CALL, std::vector<double>{}, v);
+        if (M != 0) d = delta_nbr(CALL, tags::delta_state{}, std::vector<double>{}, v);
+        bool agree = fold_hood(CALL, [](bool x, bool y){
+            return x and y;
+        }, map_hood([](std::vector<double> const& x, std::vector<double> const& y){
+            return x == y;
+        }, d, n), true);
+        if (M == 2 and node.current_time() > 5 and not agree) node.storage(tags::delta_wrong{}) += 1;
+        node.storage(tags::delta_bytes{}) += node.msg_size();
+    }
+    //! @brief Exports for the delta_async function.
+    FUN_EXPORT delta_async_t = common::export_list<std::vector<double>, delta_nbr_t<std::vector<double>>>;
+
+    //! @brief Program running delta_async.
+    template <int M>
+    struct delta_async_main {
+        template <typename node_t>
+        void operator()(node_t& node, times_t) {
+            delta_async<M>(node, 0);
+        }
+    };
+
+    //! @brief Compares delta_nbr with nbr on a value changing every 10 time units and on gossiping the maximum identifier, while devices walk in and out of range.
+    FUN void delta_churn(ARGS) { CODE
+        node.velocity() = make_vec((int(node.current_time() / 10) + node.uid) % 2 ? 1 : -1, 0);
+        double v = node.uid + int(node.current_time() / 10);
+        field<double> d = delta_nbr(CALL, tags::delta_state{}, 0.0, v);
+        field<double> n = nbr(CALL, 0.0, v);
+        node.storage(tags::delta_max{}) = delta_nbr(CALL, tags::delta_gossip{}, 0.0, [&](field<double> const& x){
+            return max_hood(CALL, x, double(node.uid));
+        });
+        node.storage(tags::nbr_max{}) = nbr(CALL, 0.0, [&](field<double> const& x){
+            return max_hood(CALL, x, double(node.uid));
+        });
+        bool agree = fold_hood(CALL, [](bool x, bool y){
+            return x and y;
+        }, map_hood([](double x, double y){
+            return x == y;
+        }, d, n), true);
+        // disagreements are allowed only on markers which could not be decoded
+        size_t missed = node.storage(tags::delta_state{}).misses;
+        if (not agree and missed == node.storage(tags::delta_missed{})) node.storage(tags::delta_wrong{}) += 1;
+        node.storage(tags::delta_missed{}) = missed;
+    }
+    //! @brief Exports for the delta_churn function.
+    FUN_EXPORT delta_churn_t = common::export_list<double, delta_nbr_t<double>>;
+
+    //! @brief Program running delta_churn.
+    struct delta_churn_main {
+        template <typename node_t>
+        void operator()(node_t& node, times_t) {
+            delta_churn(node, 0);
+        }
+    };
+}
+
+template <int O>
+DECLARE_OPTIONS(delta_options,
+    program<coordination::delta_main>,
+    round_schedule<sequence::list<distribution::constant_n<times_t, 100>>>,
+    log_schedule<sequence::list<distribution::constant_n<times_t, 100>>>,
+    exports<coordination::delta_check_t>,
+    tuple_store<delta_agree, bool, delta_state, delta_memory<double>>,
+    export_pointer<(O & 1) == 1>,
+    export_split<(O & 2) == 2>,
+    online_drop<(O & 4) == 4>,
+    parallel<(O & 8) == 8>,
+    synchronised<(O & 16) == 16>
+);
+template <int O>
+using delta_combo = component::batch_simulator<delta_options<O>>;
+
+
+MULTI_TEST(DeltaExportTest, ShortLine, O, 5) {
+    test_net<delta_combo<O>, std::tuple<bool>()> n{
+        [&](auto& node){
+            node.round_main(0.0);
+            return std::make_tuple(
+                node.storage(delta_agree{})
+            );
+        }
+    };
+    for (int i = 0; i < 8; ++i)
+        EXPECT_ROUND(n, {true, true, true});
+}
+
+// devices with random periods in [1,4] skip rounds of their neighbours and receive messages out of phase
+template <int M>
+DECLARE_OPTIONS(delta_async_options,
+    program<coordination::delta_async_main<M>>,
+    exports<coordination::delta_async_t>,
+    round_schedule<sequence::periodic<
+        distribution::interval_n<times_t, 0, 1>,
+        distribution::interval_n<times_t, 1, 4>,
+        distribution::constant_n<times_t, 100>
+    >>,
+    spawn_schedule<sequence::multiple_n<10, 0>>,
+    init<x, distribution::rect_n<1, 0, 0, 20, 20>>,
+    tuple_store<
+        delta_state,    delta_memory<std::vector<double>>,
+        delta_wrong,    int,
+        delta_bytes,    size_t
+    >,
+    connector<connect::fixed<100>>,
+    message_size<true>
+);
+
+//! @brief Runs delta_async<M>, returning the total disagreements and message size.
+template <int M>
+std::pair<int, size_t> delta_async_run() {
+    using net_t = typename component::batch_simulator<delta_async_options<M>>::net;
+    net_t network{common::make_tagged_tuple<>()};
+    network.run();
+    std::pair<int, size_t> r{0, 0};
+    for (device_t i = 0; i < 10; ++i) if (network.node_count(i)) {
+        r.first += network.node_at(i).storage(delta_wrong{});
+        r.second += network.node_at(i).storage(delta_bytes{});
+    }
+    return r;
+}
+
+TEST(DeltaExportTest, Asynchronous) {
+    EXPECT_EQ(delta_async_run<2>().first, 0);
+    size_t plain = delta_async_run<0>().second;
+    size_t delta = delta_async_run<1>().second;
+    EXPECT_GT(plain, 0u);
+    EXPECT_LT(delta, plain);
+}
+
+// devices join every 2 time units, and walk back and forth through each other's range
+DECLARE_OPTIONS(delta_churn_options,
+    program<coordination::delta_churn_main>,
+    exports<coordination::delta_churn_t>,
+    round_schedule<sequence::periodic<
+        distribution::interval_n<times_t, 0, 1>,
+        distribution::interval_n<times_t, 1, 2>,
+        distribution::constant_n<times_t, 100>
+    >>,
+    spawn_schedule<sequence::periodic<
+        distribution::constant_n<times_t, 0>,
+        distribution::constant_n<times_t, 2>,
+        distribution::constant_n<times_t, 19>
+    >>,
+    init<x, distribution::rect_n<1, 0, 0, 20, 20>>,
+    tuple_store<
+        delta_state,    delta_memory<double>,
+        delta_gossip,   delta_memory<double>,
+        delta_missed,   size_t,
+        delta_wrong,    int,
+        delta_max,      double,
+        nbr_max,        double
+    >,
+    connector<connect::fixed<8>>,
+    message_size<true>
+);
+
+TEST(DeltaExportTest, Churn) {
+    using net_t = component::batch_simulator<delta_churn_options>::net;
+    net_t network{common::make_tagged_tuple<>()};
+    network.run();
+    for (device_t i = 0; i < 10; ++i) {
+        auto& n = network.node_at(i);
+        EXPECT_EQ(0, n.storage(delta_wrong{}));
+        EXPECT_EQ(n.storage(nbr_max{}), n.storage(delta_max{}));
+    }
+}
+
+
+TEST(DeviceSetTest, Serialization) {
+    device_set sparse{1, 5, 1000}, dense, offset, empty;
+    for (device_t i = 0; i < 200; ++i) dense.insert(i);
+    for (device_t i = 6400; i < 6600; ++i) offset.insert(i);
+    for (device_set const& x : {sparse, dense, offset, empty}) {
+        common::osstream os;
+        os << x;
+        common::isstream is(os.data());
+        device_set y{7};
+        is >> y;
+        EXPECT_EQ(x, y);
+        EXPECT_EQ(x.size(), y.size());
+    }
+    // the sparse encoding is smaller than the bitset, and the dense one than the list
+    common::osstream s1, s2;
+    s1 << sparse;
+    s2 << dense;
+    EXPECT_LT(s1.size(), 3 * sizeof(device_t) + 2 * sizeof(size_t));
+    EXPECT_LT(s2.size(), 200 * sizeof(device_t));
+}
+
+TEST(DeviceSetTest, Representation) {
+    // small sets are lists regardless of their identifiers, and become bitsets as they fill up
+    device_set x{99999}, y;
+    EXPECT_FALSE(x.dense());
+    for (device_t i = 0; i < 200; ++i) y.insert(i);
+    EXPECT_TRUE(y.dense());
+    device_set z = y;
+    z.insert(x);
+    EXPECT_FALSE(z.dense());
+    EXPECT_EQ(201u, z.size());
+    // the representation does not depend on the order of insertions
+    device_set w = x;
+    for (device_t i = 200; i > 0; --i) w.insert(i-1);
+    EXPECT_EQ(z, w);
+    EXPECT_EQ(1u, w.count(99999));
+    EXPECT_EQ(1u, w.count(199));
+    EXPECT_EQ(0u, w.count(200));
+    std::vector<device_t> ids;
+    w.for_each([&](device_t d){
+        ids.push_back(d);
+    });
+    EXPECT_EQ(201u, ids.size());
+    EXPECT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+}
+
+
+namespace coordination {
+    namespace tags {
+        //! @brief Bytes attributed to the value shared with neighbours.
+        struct size_shared {};
+
+        //! @brief Bytes attributed to a value which is not exported.
+        struct size_extra {};
+
+        //! @brief Bytes of the messages not attributed to functions.
+        struct size_other {};
+
+        //! @brief Total bytes of the messages.
+        struct size_total {};
+    }
+
+    //! @brief Attributes a shared value, and on even devices also a large value which is not exported.
+    FUN void size_check(ARGS) { CODE
+        attribute_remainder(node, tags::size_other{});
+        node.storage(tags::size_total{}) += node.msg_size();
+        double v = node.uid + node.current_time();
+        nbr(CALL, 0.0, v);
+        attribute_bytes(CALL, tags::size_shared{}, v);
+        if (node.uid % 2 == 0)
+            attribute_bytes(CALL, tags::size_extra{}, std::vector<double>(64, v));
+    }
+    //! @brief Exports for the size_check function.
+    FUN_EXPORT size_check_t = common::export_list<double>;
+
+    //! @brief Program running size_check.
+    struct size_main {
+        template <typename node_t>
+        void operator()(node_t& node, times_t) {
+            size_check(node, 0);
+        }
+    };
+}
+
+template <int O>
+DECLARE_OPTIONS(size_options,
+    program<coordination::size_main>,
+    exports<coordination::size_check_t>,
+    round_schedule<sequence::periodic<
+        distribution::interval_n<times_t, 0, 1>,
+        distribution::interval_n<times_t, 1, 2>,
+        distribution::constant_n<times_t, 20>
+    >>,
+    spawn_schedule<sequence::multiple_n<6, 0>>,
+    init<x, distribution::rect_n<1, 0, 0, 10, 10>>,
+    tuple_store<
+        size_shared,        size_t,
+        size_extra,         size_t,
+        size_other,         size_t,
+        size_total,         size_t,
+        attributed_bytes,   attribution::ledger
+    >,
+    connector<connect::fixed<100>>,
+    message_size<true>,
+    export_pointer<(O & 1) == 1>,
+    export_split<(O & 2) == 2>,
+    online_drop<(O & 4) == 4>,
+    parallel<(O & 8) == 8>,
+    synchronised<(O & 16) == 16>
+);
+
+
+MULTI_TEST(ExportSizeTest, Attribution, O, 5) {
+    using net_t = typename component::batch_simulator<size_options<O>>::net;
+    net_t network{common::make_tagged_tuple<>()};
+    network.run();
+    for (device_t i = 0; i < 6; ++i) {
+        auto& n = network.node_at(i);
+        // the parts sum to the messages, also when the attributed bytes exceed them
+        size_t total = n.storage(size_total{});
+        EXPECT_GT(total, 0u);
+        EXPECT_EQ(total, n.storage(size_shared{}) + n.storage(size_extra{}) + n.storage(size_other{}));
+        EXPECT_GT(n.storage(size_shared{}), 0u);
+        EXPECT_EQ(i % 2 == 0, n.storage(size_extra{}) > 0);
+    }
+}
+
+
+namespace coordination {
+    namespace tags {
+        //! @brief Whether handover_distances agreed with abf_distance from the current source in the last round.
+        struct current_agree {};
+
+        //! @brief Whether handover_distances agreed with abf_distance from the upcoming source in the last round.
+        struct upcoming_agree {};
+    }
+
+    //! @brief Compares handover_distances on a line (with sources switching every 10 time units, warmed up 5 before) with an abf_distance per source.
+    FUN void handover_check(ARGS) { CODE
+        times_t t = node.current_time();
+        int w = int(t) / 10;
+        std::array<double, 3> r{{abf_distance(CALL, node.uid == 0), abf_distance(CALL, node.uid == 1), abf_distance(CALL, node.uid == 2)}};
+        tuple<double, double> h = handover_distances(CALL, 10, 5);
+        // gradients are compared once converged (after three rounds on a line of three devices)
+        node.storage(tags::current_agree{}) = t < 3 or get<0>(h) == r[w];
+        if (t < (w+1)*10 - 5) node.storage(tags::upcoming_agree{}) = std::isinf(get<1>(h));
+        else node.storage(tags::upcoming_agree{}) = t < (w+1)*10 - 2 or get<1>(h) == r[w+1];
+    }
+    //! @brief Exports for the handover_check function.
+    FUN_EXPORT handover_check_t = common::export_list<abf_distance_t, handover_distances_t>;
+
+    //! @brief Program running handover_check.
+    struct handover_main {
+        template <typename node_t>
+        void operator()(node_t& node, times_t) {
+            handover_check(node, 0);
+        }
+    };
+}
+
+template <int O>
+DECLARE_OPTIONS(handover_options,
+    program<coordination::handover_main>,
+    round_schedule<sequence::list<distribution::constant_n<times_t, 100>>>,
+    log_schedule<sequence::list<distribution::constant_n<times_t, 100>>>,
+    exports<coordination::handover_check_t>,
+    tuple_store<current_agree, bool, upcoming_agree, bool>,
+    export_pointer<(O & 1) == 1>,
+    export_split<(O & 2) == 2>,
+    online_drop<(O & 4) == 4>,
+    parallel<(O & 8) == 8>,
+    synchronised<(O & 16) == 16>
+);
+template <int O>
+using handover_combo = component::batch_simulator<handover_options<O>>;
+
+
+// the warm gradient matches the upcoming source before the switch, and the current source after it
+MULTI_TEST(HandoverTest, Line, O, 5) {
+    times_t t = 0;
+    test_net<handover_combo<O>, std::tuple<bool, bool>()> n{
+        [&](auto& node){
+            node.round_main(t);
+            return std::make_tuple(
+                node.storage(current_agree{}),
+                node.storage(upcoming_agree{})
+            );
+        }
+    };
+    for (; t < 20; ++t)
+        EXPECT_ROUND(n, {true, true, true}, {true, true, true});
+}
+
+
+namespace coordination {
+    namespace tags {
+        //! @brief Messages delivered by single_dispatch.
+        struct single_delivered {};
+
+        //! @brief Messages delivered by batched_dispatch.
+        struct batched_delivered {};
+    }
+
+    //! @brief Exchanges messages between the ends of a line of three devices, dispatching them both one by one and in batches.
+    FUN void dispatch_check(ARGS) { CODE
+        node.position() = make_vec(10 * node.uid, 0);
+        int k = int(node.current_time());
+        // messages every three time units from each end, two of them in every window of batch_window
+        common::option<message> m;
+        if (k < 30 and node.uid == 0 and k % 3 == 1) m.emplace(0, 2, k);
+        if (k < 30 and node.uid == 2 and k % 3 == 2) m.emplace(2, 0, k);
+        set_t below{0, 1, 2};
+        std::vector<color> procs;
+        for (auto const& x : single_dispatch(CALL, below, m, procs)) node.storage(tags::single_delivered{}).insert(x.first);
+        for (auto const& x : batched_dispatch(CALL, below, m, procs)) node.storage(tags::batched_delivered{}).insert(x.first);
+    }
+    //! @brief Exports for the dispatch_check function.
+    FUN_EXPORT dispatch_check_t = common::export_list<single_dispatch_t, batched_dispatch_t>;
+
+    //! @brief Program running dispatch_check.
+    struct dispatch_main {
+        template <typename node_t>
+        void operator()(node_t& node, times_t) {
+            dispatch_check(node, 0);
+        }
+    };
+}
+
+// three devices in a line with synchronous rounds every time unit
+DECLARE_OPTIONS(dispatch_options,
+    program<coordination::dispatch_main>,
+    exports<coordination::dispatch_check_t>,
+    round_schedule<sequence::periodic<
+        distribution::constant_n<times_t, 0>,
+        distribution::constant_n<times_t, 1>,
+        distribution::constant_n<times_t, 50>
+    >>,
+    spawn_schedule<sequence::multiple_n<3, 0>>,
+    init<x, distribution::rect_n<1, 0, 0, 20, 0>>,
+    tuple_store<
+        single_delivered,   std::set<message>,
+        batched_delivered,  std::set<message>,
+        process_bytes,      size_t,
+        attributed_bytes,   attribution::ledger
+    >,
+    connector<connect::fixed<15>>
+);
+
+TEST(MessageDispatchTest, SameDeliveries) {
+    using net_t = component::batch_simulator<dispatch_options>::net;
+    net_t network{common::make_tagged_tuple<>()};
+    network.run();
+    for (device_t i = 0; i < 3; ++i) {
+        auto& n = network.node_at(i);
+        EXPECT_EQ(n.storage(single_delivered{}), n.storage(batched_delivered{}));
+        EXPECT_EQ(i == 1 ? 0u : 10u, n.storage(batched_delivered{}).size());
+    }
+}
+
+
+namespace coordination {
+    namespace tags {
+        //! @brief Whether bis_gradients agreed with bis_distance from the first source in the last round.
+        struct first_agree {};
+
+        //! @brief Whether bis_gradients agreed with bis_distance from the second source in the last round.
+        struct second_agree {};
+    }
+
+    //! @brief Compares bis_gradients from the two ends of a line with a bis_distance per source.
+    FUN void gradients_check(ARGS) { CODE
+        std::array<bool, 2> sources{{node.uid == 0, node.uid == 2}};
+        gradients<2> g = bis_gradients(CALL, sources, [](std::array<real_t, 2> const& d){
+            return d;
+        }, 1, 0.5);
+        real_t d0 = bis_distance(CALL, sources[0], 1, 0.5);
+        real_t d1 = bis_distance(CALL, sources[1], 1, 0.5);
+        node.storage(tags::first_agree{}) = g.dist[0] == d0;
+        node.storage(tags::second_agree{}) = g.dist[1] == d1;
+    }
+    //! @brief Exports for the gradients_check function.
+    FUN_EXPORT gradients_check_t = common::export_list<bis_gradients_t<2>, bis_distance_t>;
+
+    //! @brief Program running gradients_check.
+    struct gradients_main {
+        template <typename node_t>
+        void operator()(node_t& node, times_t) {
+            gradients_check(node, 0);
+        }
+    };
+}
+
+template <int O>
+DECLARE_OPTIONS(gradients_options,
+    program<coordination::gradients_main>,
+    round_schedule<sequence::list<distribution::constant_n<times_t, 100>>>,
+    log_schedule<sequence::list<distribution::constant_n<times_t, 100>>>,
+    exports<coordination::gradients_check_t>,
+    tuple_store<first_agree, bool, second_agree, bool>,
+    export_pointer<(O & 1) == 1>,
+    export_split<(O & 2) == 2>,
+    online_drop<(O & 4) == 4>,
+    parallel<(O & 8) == 8>,
+    synchronised<(O & 16) == 16>
+);
+template <int O>
+using gradients_combo = component::batch_simulator<gradients_options<O>>;
+
+
+MULTI_TEST(MultiGradientTest, ShortLine, O, 5) {
+    test_net<gradients_combo<O>, std::tuple<bool, bool>()> n{
+        [&](auto& node){
+            node.round_main(0.0);
+            return std::make_tuple(
+                node.storage(first_agree{}),
+                node.storage(second_agree{})
+            );
+        }
+    };
+    for (int i = 0; i < 8; ++i)
+        EXPECT_ROUND(n, {true, true, true}, {true, true, true});
+}
+
+//! @brief A grid of unit cells in [0,12] x [0,9], with obstacles on a fixed pattern of cells.
+struct obstacle_grid {
+    //! @brief Whether the cell of a point is an obstacle.
+    bool is_obstacle(vec<3> const& p) const {
+        int i = p[0], j = p[1];
+        return (i * 7 + j * 13) % 11 == 0 or (i >= 4 and i < 7 and j >= 3 and j < 5);
+    }
+};
+
+//! @brief The centre of the feature cell of a point `q` returned by an index for a query at the centre `p` of another cell.
+vec<3> feature_cell(vec<3> const& p, vec<3> const& q) {
+    vec<3> c = q;
+    for (size_t k = 0; k < 2; ++k) c[k] += q[k] < p[k] ? -0.5 : q[k] > p[k] ? 0.5 : 0;
+    return c;
+}
+
+TEST(ObstacleIndexTest, BruteForce) {
+    obstacle_grid g;
+    obstacle_index idx(g, 0, 0, 12, 9, 1);
+    for (int i = 0; i < 12; ++i) for (int j = 0; j < 9; ++j) {
+        vec<3> p = make_vec(i + 0.5, j + 0.5, 2);
+        EXPECT_EQ(g.is_obstacle(p), idx.is_obstacle(p));
+        // closest cell centres with and without obstacles, by brute force
+        real_t obst = std::numeric_limits<real_t>::infinity(), space = obst;
+        for (int x = 0; x < 12; ++x) for (int y = 0; y < 9; ++y) {
+            vec<3> c = make_vec(x + 0.5, y + 0.5, 2);
+            real_t d = norm(c - p);
+            if (g.is_obstacle(c)) obst = std::min(obst, d);
+            else space = std::min(space, d);
+        }
+        vec<3> qo = idx.closest_obstacle(p), qs = idx.closest_space(p);
+        vec<3> co = feature_cell(p, qo), cs = feature_cell(p, qs);
+        EXPECT_TRUE(g.is_obstacle(co));
+        EXPECT_FALSE(g.is_obstacle(cs));
+        EXPECT_DOUBLE_EQ(obst, norm(co - p));
+        EXPECT_DOUBLE_EQ(space, norm(cs - p));
+        // the returned points are on the boundary of the feature cells, and keep further coordinates
+        EXPECT_LE(norm(qo - p), norm(co - p));
+        EXPECT_EQ(2, qo[2]);
+    }
+    // without obstacles, the closest obstacle is at infinite distance
+    obstacle_index empty;
+    EXPECT_TRUE(std::isinf(empty.closest_obstacle(make_vec(1, 1))[0]));
+}
+
+
+namespace coordination {
+    namespace tags {
+        //! @brief Times of the rounds performed.
+        struct quiet_times {};
+
+        //! @brief Back-off factors returned in the rounds performed.
+        struct quiet_factors {};
+    }
+
+    //! @brief Backs off the rounds of a device whose inputs change only during [20,26).
+    struct quiescence_main {
+        template <typename node_t>
+        void operator()(node_t& node, times_t) {
+            times_t t = node.current_time();
+            real_t change = t >= 20 and t < 26 ? 1 : 0;
+            node.storage(tags::quiet_times{}).push_back(t);
+            node.storage(tags::quiet_factors{}).push_back(quiescence(node, 0, change, 0.5, 4));
+        }
+    };
+}
+
+// a single device with a round planned every time unit
+DECLARE_OPTIONS(quiescence_options,
+    program<coordination::quiescence_main>,
+    exports<coordination::quiescence_t>,
+    round_schedule<sequence::periodic_n<1, 0, 1, 60>>,
+    spawn_schedule<sequence::multiple_n<1, 0>>,
+    tuple_store<
+        quiet_times,    std::vector<times_t>,
+        quiet_factors,  std::vector<int>
+    >
+);
+
+TEST(QuiescenceTest, BackOff) {
+    using net_t = component::batch_simulator<quiescence_options>::net;
+    net_t network{common::make_tagged_tuple<>()};
+    network.run();
+    auto& n = network.node_at(0);
+    std::vector<times_t> const& t = n.storage(quiet_times{});
+    std::vector<int> const& f = n.storage(quiet_factors{});
+    ASSERT_GT(t.size(), 20u);
+    // the interval until the next round is the planned one stretched by the factor
+    for (size_t i = 0; i + 1 < t.size(); ++i)
+        EXPECT_DOUBLE_EQ(f[i], t[i+1] - t[i]);
+    // the first stable rounds are not stretched, the following ones double up to the maximum
+    EXPECT_EQ((std::vector<int>{1, 1, 1, 2, 4, 4}), std::vector<int>(f.begin(), f.begin() + 6));
+    // a change restores the planned schedule, until stable again
+    size_t c = std::find_if(t.begin(), t.end(), [](times_t x){ return x >= 20; }) - t.begin();
+    size_t s = std::find_if(t.begin(), t.end(), [](times_t x){ return x >= 26; }) - t.begin();
+    ASSERT_LT(c, s);
+    ASSERT_LT(s + 5, t.size());
+    for (size_t i = c; i < s; ++i)
+        EXPECT_EQ(1, f[i]);
+    EXPECT_EQ((std::vector<int>{1, 1, 1, 2, 4}), std::vector<int>(f.begin() + s, f.begin() + s + 5));
+}
+
+
+//! @brief A node state identified by a number.
+recording::node_state numbered_state(int k) {
+    recording::node_state s;
+    s.position = {{float(k), 0, 0}};
+    s.size = 1;
+    s.shape = uint8_t(k % 2);
+    s.colors[0] = k;
+    return s;
+}
+
+TEST(RecordingTest, RoundTrip) {
+    // frames at every time unit with a key frame every three, a second node appearing at time 5
+    {
+        recording::writer w("recording_test", 1, 1, 3);
+        for (int k = 0; k < 10; ++k) {
+            w.record(k + 0.5, 0, numbered_state(k));
+            if (k >= 4) w.record(k + 0.5, 1, numbered_state(2*k));
+        }
+    }
+    recording::reader r("recording_test");
+    ASSERT_TRUE(r.good());
+    EXPECT_EQ(1u, r.colors());
+    EXPECT_EQ(2u, r.devices());
+    EXPECT_EQ(0, r.start());
+    EXPECT_EQ(10, r.end());
+    // seeking backwards and forwards, and past the end
+    for (double t : {7.2, 2.5, 9.9, 0.5, 5.0, 4.9, 12.0}) {
+        int f = std::min(int(t), 10);
+        std::vector<recording::node_state> const& v = r.at(t);
+        EXPECT_EQ(f >= 1, v[0].present);
+        if (f >= 1) {
+            EXPECT_EQ(float(f-1), v[0].position[0]);
+            EXPECT_EQ(uint8_t((f-1) % 2), v[0].shape);
+            EXPECT_EQ(uint32_t(f-1), v[0].colors[0]);
+        }
+        EXPECT_EQ(f >= 5, v[1].present);
+        if (f >= 5) EXPECT_EQ(uint32_t(2*(f-1)), v[1].colors[0]);
+    }
+    // a truncated last frame is dropped
+    std::vector<char> data(1 << 16);
+    FILE* in = std::fopen("recording_test", "rb");
+    data.resize(std::fread(data.data(), 1, data.size(), in));
+    std::fclose(in);
+    FILE* out = std::fopen("recording_cut", "wb");
+    std::fwrite(data.data(), 1, data.size() - 3, out);
+    std::fclose(out);
+    recording::reader c("recording_cut");
+    ASSERT_TRUE(c.good());
+    EXPECT_EQ(9, c.end());
+    EXPECT_EQ(float(8), c.at(20).at(0).position[0]);
+    std::remove("recording_test");
+    std::remove("recording_cut");
+}
+
+
+namespace coordination {
+    namespace tags {
+        //! @brief The parameter of a cached simulation.
+        struct cache_point {};
+
+        //! @brief The value computed by a cached simulation.
+        struct cache_value {};
+    }
+
+    //! @brief Program storing the parameter of the simulation times the current time, times `k`.
+    template <int k>
+    struct cache_main {
+        template <typename node_t>
+        void operator()(node_t& node, times_t t) {
+            node.storage(tags::cache_value{}) = k * node.storage(tags::cache_point{}) * t;
+        }
+    };
+}
+
+//! @brief Plotter collecting the values of the rows it receives.
+struct cache_rows {
+    std::vector<std::vector<double>> rows;
+
+    template <typename R>
+    cache_rows& operator<<(R const& row) {
+        std::vector<double> k, v;
+        sweep::details::row_split<R>::split(row, k, v);
+        rows.push_back(v);
+        return *this;
+    }
+};
+
+template <int k>
+DECLARE_OPTIONS(cache_options,
+    program<coordination::cache_main<k>>,
+    exports<double>,
+    round_schedule<sequence::periodic_n<1, 0, 1, 4>>,
+    log_schedule<sequence::periodic_n<1, 0, 1, 4>>,
+    spawn_schedule<sequence::multiple_n<1, 0>>,
+    tuple_store<cache_point, double, cache_value, double>,
+    aggregators<cache_value, aggregator::sum<double>>,
+    init<cache_point, distribution::constant_i<double, cache_point>>,
+    extra_info<cache_point, double>,
+    plot_type<cache::writer<cache_rows>>
+);
+
+//! @brief The initialisation values of cached simulations with the given parameters.
+std::vector<common::tagged_tuple_t<cache_point, double, output, std::ostream*>> cache_points(std::vector<double> const& v) {
+    std::vector<common::tagged_tuple_t<cache_point, double, output, std::ostream*>> r;
+    for (double x : v) r.push_back(common::make_tagged_tuple<cache_point, output>(x, &columnar::null_stream()));
+    return r;
+}
+
+TEST(ResultCacheTest, Incremental) {
+    auto small = cache_points({1, 2});
+    auto large = cache_points({1, 2, 3, 3});
+    // the binary hash is computed once per process
+    EXPECT_EQ(cache::details::binary_hash(), cache::details::binary_hash());
+    EXPECT_NE(cache::options_hash<cache_options<1>>(), cache::options_hash<cache_options<2>>());
+    cache_rows fresh, first, second, cached;
+    EXPECT_EQ(3u, cache::run<cache_options<1>>(large, fresh, "result_cache_fresh", 2));
+    // an extended sweep only simulates the new points, and replays the same rows as a fresh one
+    EXPECT_EQ(2u, cache::run<cache_options<1>>(small, first, "result_cache_test", 2));
+    EXPECT_EQ(1u, cache::run<cache_options<1>>(large, second, "result_cache_test", 2));
+    EXPECT_EQ(0u, cache::run<cache_options<1>>(large, cached, "result_cache_test", 2));
+    ASSERT_FALSE(fresh.rows.empty());
+    EXPECT_EQ(fresh.rows, second.rows);
+    EXPECT_EQ(fresh.rows, cached.rows);
+    EXPECT_EQ(first.rows, std::vector<std::vector<double>>(fresh.rows.begin(), fresh.rows.begin() + first.rows.size()));
+    // a changed key misses the cache
+    cache_rows other;
+    EXPECT_EQ(3u, cache::run<cache_options<2>>(large, other, "result_cache_test", 2));
+    EXPECT_NE(fresh.rows, other.rows);
+    for (auto const& x : large) {
+        std::remove(cache::entry_path<cache_options<1>>("result_cache_fresh", x).c_str());
+        std::remove(cache::entry_path<cache_options<1>>("result_cache_test", x).c_str());
+        std::remove(cache::entry_path<cache_options<2>>("result_cache_test", x).c_str());
+    }
+    std::remove("result_cache_fresh");
+    std::remove("result_cache_test");
+}
+
+
+TEST(SnapshotTest, Board) {
+    using state_t = snapshot::device_state<2>;
+    snapshot::board<state_t> b(600);
+    EXPECT_EQ(768u, b.capacity());
+    state_t s;
+    EXPECT_FALSE(b.read(3, s));
+    EXPECT_FALSE(b.read(1000, s));
+    b.publish(3, {true, 2, make_vec(1, 2), make_vec(1, 0)});
+    b.publish(300, {true, 4, make_vec(5, 5), make_vec(0, -1)});
+    // devices read back the last publication of the slot, even when unpublished slots share the block
+    ASSERT_TRUE(b.read(3, s));
+    EXPECT_EQ(2, s.time);
+    EXPECT_EQ(make_vec(2, 2), s.position_at(3));
+    EXPECT_FALSE(b.read(4, s));
+    EXPECT_FALSE(b.read(299, s));
+    ASSERT_TRUE(b.read(300, s));
+    EXPECT_EQ(make_vec(5, 3), s.position_at(6));
+    b.publish(3, {true, 5, make_vec(0, 0), make_vec(0, 0)});
+    ASSERT_TRUE(b.read(3, s));
+    EXPECT_EQ(5, s.time);
+    EXPECT_THROW(b.publish(768, s), std::out_of_range);
+}
+
+TEST(SnapshotTest, Concurrent) {
+    using state_t = snapshot::device_state<2>;
+    constexpr int threads = 4, devices = 64, rounds = 20000;
+    snapshot::board<state_t> b(devices);
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0}, backwards{0};
+    std::vector<std::thread> ts;
+    // every writer publishes states of its own devices, all of whose fields are derived from a counter
+    for (int k = 0; k < threads; ++k) ts.emplace_back([&,k](){
+        for (int c = 1; c <= rounds; ++c)
+            for (int d = k; d < devices; d += threads)
+                b.publish(d, {true, times_t(c), make_vec(c, d), make_vec(-c, -d)});
+    });
+    // readers check that states are never mixed, and never go back in time
+    for (int k = 0; k < threads; ++k) ts.emplace_back([&,k](){
+        std::vector<times_t> last(devices, 0);
+        for (int i = 0; not done; ++i) {
+            int d = (i * 7 + k) % devices;
+            state_t s;
+            if (not b.read(d, s)) continue;
+            if (s.position != make_vec(s.time, d) or s.velocity != make_vec(-s.time, -d)) ++torn;
+            if (s.time < last[d]) ++backwards;
+            last[d] = s.time;
+        }
+    });
+    for (int k = 0; k < threads; ++k) ts[k].join();
+    done = true;
+    for (int k = threads; k < 2*threads; ++k) ts[k].join();
+    EXPECT_EQ(0, torn);
+    EXPECT_EQ(0, backwards);
+    state_t s;
+    for (int d = 0; d < devices; ++d) {
+        ASSERT_TRUE(b.read(d, s));
+        EXPECT_EQ(rounds, s.time);
+    }
+}
+
+
+TEST(WindowedMapTest, Eviction) {
+    // four generations of 10 time units: entries are kept for 30 to 40 time units
+    windowed_map<int, times_t> m(30);
+    m.advance(0);
+    m.insert(1, 0);
+    m.advance(9.5);
+    m.insert(2, 9.5);
+    m.advance(10);
+    m.insert(3, 10);
+    m.advance(39.5);
+    EXPECT_EQ(m.count(1), 1ULL);
+    EXPECT_EQ(m.count(2), 1ULL);
+    EXPECT_EQ(m.count(3), 1ULL);
+    m.advance(40);
+    EXPECT_EQ(m.count(1), 0ULL);
+    EXPECT_EQ(m.count(2), 0ULL);
+    EXPECT_EQ(m.count(3), 1ULL);
+    // reinserting an entry renews it
+    m.insert(3, 40);
+    m.advance(69.5);
+    EXPECT_EQ(m.count(3), 1ULL);
+    EXPECT_EQ(m.size(), 1ULL);
+    // jumps longer than the ring clear everything
+    m.advance(1000);
+    EXPECT_EQ(m.size(), 0ULL);
+    // the default window is infinite
+    windowed_map<int, times_t> d;
+    d.insert(1, 0);
+    d.advance(1000);
+    EXPECT_EQ(d.count(1), 1ULL);
+}